@@ -0,0 +1,126 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcPvGetBench.cpp
+*
+*  Created on: Oct 17, 2026
+*      Author: anderssandstrom
+*
+*  Micro benchmark of the pv_get() read path. One thread floods value
+*  updates (like ecmcPv::event()) while another thread reads (like the
+*  ecmc realtime thread) and records the time of each read. Compares
+*  the old mutex protected value with ecmcPvSeqLock.
+*
+*  Usage: ecmcPvGetBench [<reads>] [<cpu>]
+*    reads : number of timed reads per variant (default 2000000)
+*    cpu   : pin both threads to this cpu (default not pinned). Pinning
+*            shows what happens when the writer is preempted inside
+*            its critical section by the reader.
+*
+\*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "ecmcPvSeqLock.h"
+
+typedef std::chrono::steady_clock benchClock;
+
+// Old implementation (epicsMutex is a pthread mutex on Linux)
+class mutexValue {
+ public:
+  mutexValue() : value_(0) {}
+  void write(double value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    value_ = value;
+  }
+  double read() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return value_;
+  }
+ private:
+  std::mutex mutex_;
+  double     value_;
+};
+
+static void pinThread(int cpu) {
+  if(cpu < 0) {
+    return;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+static void report(const char *name, std::vector<long> &samples, long writes) {
+  std::sort(samples.begin(), samples.end());
+  double sum = 0;
+  for(size_t i = 0; i < samples.size(); ++i) {
+    sum += samples[i];
+  }
+  size_t n = samples.size();
+  printf("%-10s reads=%zu writes=%ld avg=%.1fns p50=%ldns p99=%ldns "
+         "p99.9=%ldns p99.99=%ldns max=%ldns\n",
+         name, n, writes, sum / n, samples[n / 2], samples[n * 99 / 100],
+         samples[n * 999 / 1000], samples[n * 9999 / 10000], samples[n - 1]);
+}
+
+template <typename V>
+static void run(const char *name, long reads, int cpu) {
+  V value;
+  std::atomic<bool> stop(false);
+  std::atomic<long> writes(0);
+  std::vector<long> samples(reads);
+
+  std::thread writer([&]() {
+    pinThread(cpu);
+    double x = 0;
+    while(!stop.load(std::memory_order_relaxed)) {
+      value.write(x);
+      x += 1;
+      writes.fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+
+  pinThread(cpu);
+  volatile double sink = 0;
+  for(long i = 0; i < reads; ++i) {
+    benchClock::time_point t0 = benchClock::now();
+    sink = value.read();
+    benchClock::time_point t1 = benchClock::now();
+    samples[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+  }
+  (void)sink;
+  stop = true;
+  writer.join();
+  report(name, samples, writes.load());
+}
+
+int main(int argc, char **argv) {
+  long reads = 2000000;
+  int  cpu   = -1;
+  if(argc > 1) {
+    reads = atol(argv[1]);
+  }
+  if(argc > 2) {
+    cpu = atoi(argv[2]);
+  }
+  if(reads <= 0) {
+    printf("Error: Invalid read count.\n");
+    return 1;
+  }
+
+  run<mutexValue>("mutex", reads, cpu);
+  run<ecmcPvSeqLock<double> >("seqlock", reads, cpu);
+  return 0;
+}
@@ -0,0 +1,413 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcPvaBench.cpp
+*
+*  Created on: Oct 17, 2026
+*      Author: anderssandstrom
+*
+*  End to end benchmark of the plugin without ecmc or a second ioc.
+*  Starts an in-process pvAccess server (loopback only) with scalar,
+*  enum and array pvs, registers them through the ecmcPvaWrap C API
+*  and drives the plc functions from a simulated realtime loop.
+*  Checks that registering a registered pv again reuses its handle.
+*  Reports time per rt call, cycle jitter, put throughput, memory per pv
+*  and process cpu time per monitor event (includes the server).
+*
+*  Usage: ecmcPvaBench [<pvs>] [<rate>] [<seconds>] [<mode>] [<array size>]
+*                      [<backend>]
+*    pvs        : number of pvs of each type (default 10)
+*    rate       : rt loop rate [Hz] (default 1000)
+*    seconds    : duration of timed run (default 10)
+*    mode       : put mode: asyn, latest or batch (default asyn)
+*    array size : elements of array pvs (default 1000)
+*    backend    : client api: pvaClient or pvac (default pvaClient)
+*
+\*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include <pv/pvData.h>
+#include <pv/serverContext.h>
+#include <pv/sharedPV.h>
+
+#include "ecmcPvaWrap.h"
+#include "ecmcPvDefs.h"
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+#define BENCH_PREFIX   "ECMC_PVA_BENCH:"
+#define BENCH_PROVIDER "pva"
+#define BENCH_REREG_COUNT 1000  // Registrations of an already registered pv
+
+// Normally provided by ecmc
+extern "C" int getEcmcEpicsIOCState() {
+  return ECMC_IOC_STARTED_STATE;
+}
+
+enum benchPutMode {
+  BENCH_PUT_ASYN   = 0,
+  BENCH_PUT_LATEST = 1,
+  BENCH_PUT_BATCH  = 2
+};
+
+struct benchServerPv {
+  std::string                   name;
+  pvas::SharedPV::shared_pointer pv;
+  pvd::PVStructurePtr           value;
+};
+
+static uint64_t nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static long rssBytes() {
+  long pages = 0, resident = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if(!f) {
+    return 0;
+  }
+  if(fscanf(f, "%ld %ld", &pages, &resident) != 2) {
+    resident = 0;
+  }
+  fclose(f);
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+static void report(const char *name, std::vector<long> &samples) {
+  if(samples.empty()) {
+    printf("%-12s no samples\n", name);
+    return;
+  }
+  std::sort(samples.begin(), samples.end());
+  double sum = 0;
+  for(size_t i = 0; i < samples.size(); ++i) {
+    sum += samples[i];
+  }
+  size_t n = samples.size();
+  printf("%-12s calls=%zu avg=%.1fns p50=%ldns p99=%ldns "
+         "p99.9=%ldns p99.99=%ldns max=%ldns\n",
+         name, n, sum / n, samples[n / 2], samples[n * 99 / 100],
+         samples[n * 999 / 1000], samples[n * 9999 / 10000], samples[n - 1]);
+}
+
+static pvd::StructureConstPtr scalarType() {
+  return pvd::getFieldCreate()->createFieldBuilder()
+           ->setId("epics:nt/NTScalar:1.0")
+           ->add("value", pvd::pvDouble)
+           ->createStructure();
+}
+
+static pvd::StructureConstPtr enumType() {
+  return pvd::getFieldCreate()->createFieldBuilder()
+           ->setId("epics:nt/NTEnum:1.0")
+           ->addNestedStructure("value")
+             ->setId("enum_t")
+             ->add("index", pvd::pvInt)
+             ->addArray("choices", pvd::pvString)
+             ->endNested()
+           ->createStructure();
+}
+
+static pvd::StructureConstPtr arrayType() {
+  return pvd::getFieldCreate()->createFieldBuilder()
+           ->setId("epics:nt/NTScalarArray:1.0")
+           ->addArray("value", pvd::pvDouble)
+           ->createStructure();
+}
+
+static void addServerPv(pvas::StaticProvider &provider,
+                        std::vector<benchServerPv> &pvs,
+                        const std::string &name,
+                        pvd::StructureConstPtr const &type) {
+  benchServerPv entry;
+  entry.name  = name;
+  entry.value = pvd::getPVDataCreate()->createPVStructure(type);
+  // Puts are stored and posted to monitors
+  entry.pv    = pvas::SharedPV::buildMailbox();
+  entry.pv->open(*entry.value);
+  provider.add(name, entry.pv);
+  pvs.push_back(entry);
+}
+
+// Post new values to the scalar and array pvs (monitor events)
+static void updateServerPvs(std::vector<benchServerPv> &scalars,
+                            std::vector<benchServerPv> &arrays,
+                            size_t arraySize, double x) {
+  for(size_t i = 0; i < scalars.size(); ++i) {
+    pvd::PVDoublePtr field = scalars[i].value->getSubFieldT<pvd::PVDouble>("value");
+    field->put(x);
+    pvd::BitSet changed;
+    changed.set(field->getFieldOffset());
+    scalars[i].pv->post(*scalars[i].value, changed);
+  }
+  for(size_t i = 0; i < arrays.size(); ++i) {
+    pvd::PVDoubleArrayPtr field = arrays[i].value->getSubFieldT<pvd::PVDoubleArray>("value");
+    pvd::PVDoubleArray::svector data(arraySize, x);
+    field->replace(pvd::freeze(data));
+    pvd::BitSet changed;
+    changed.set(field->getFieldOffset());
+    arrays[i].pv->post(*arrays[i].value, changed);
+  }
+}
+
+static void setRtPrio() {
+  struct sched_param param;
+  memset(&param, 0, sizeof(param));
+  param.sched_priority = 80;
+  if(pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)) {
+    printf("Warning: Could not set SCHED_FIFO (run as root for rt prio).\n");
+  }
+}
+
+// User + system cpu time of process [ns]
+static uint64_t cpuNs() {
+  struct rusage usage;
+  if(getrusage(RUSAGE_SELF, &usage)) {
+    return 0;
+  }
+  return ((uint64_t)usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000ull +
+         ((uint64_t)usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ull;
+}
+
+int main(int argc, char **argv) {
+  int         pvCount   = 10;
+  double      rate      = 1000;
+  double      seconds   = 10;
+  int         mode      = BENCH_PUT_ASYN;
+  size_t      arraySize = 1000;
+  const char *backend   = ECMC_PV_BACKEND_NAME_PVACLIENT;
+  const char *modeNames[] = {"asyn", "latest", "batch"};
+
+  if(argc > 1) {
+    pvCount = atoi(argv[1]);
+  }
+  if(argc > 2) {
+    rate = atof(argv[2]);
+  }
+  if(argc > 3) {
+    seconds = atof(argv[3]);
+  }
+  if(argc > 4) {
+    for(int i = 0; i < 3; ++i) {
+      if(strcmp(argv[4], modeNames[i]) == 0) {
+        mode = i;
+      }
+    }
+  }
+  if(argc > 5) {
+    arraySize = (size_t)atol(argv[5]);
+  }
+  if(argc > 6) {
+    backend = argv[6];
+  }
+  if(pvCount <= 0 || rate <= 0 || seconds <= 0 || arraySize == 0) {
+    printf("Error: Invalid argument.\n");
+    return 1;
+  }
+
+  // Loopback only (no network needed)
+  setenv("EPICS_PVA_AUTO_ADDR_LIST", "NO", 1);
+  setenv("EPICS_PVA_ADDR_LIST", "127.0.0.1", 1);
+  setenv("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1", 1);
+
+  // Server
+  pvas::StaticProvider provider("ecmcPvaBench");
+  std::vector<benchServerPv> scalars, enums, arrays;
+  char name[64];
+  for(int i = 0; i < pvCount; ++i) {
+    snprintf(name, sizeof(name), BENCH_PREFIX "AO%d", i);
+    addServerPv(provider, scalars, name, scalarType());
+    snprintf(name, sizeof(name), BENCH_PREFIX "BO%d", i);
+    addServerPv(provider, enums, name, enumType());
+    snprintf(name, sizeof(name), BENCH_PREFIX "WF%d", i);
+    addServerPv(provider, arrays, name, arrayType());
+  }
+  updateServerPvs(scalars, arrays, arraySize, 0);
+  pva::ServerContext::shared_pointer server(
+      pva::ServerContext::create(pva::ServerContext::Config().provider(provider.provider())));
+
+  // Plugin (all pv objects allocated by initPvs(), no pool growth while registering)
+  int totalPvs = 3 * pvCount;
+  char config[160];
+  snprintf(config, sizeof(config), ECMC_PV_OPTION_MAX_PV_COUNT "=%d;"
+           ECMC_PV_OPTION_INIT_PV_COUNT "=%d;"
+           ECMC_PV_OPTION_MAX_ARRAY_SIZE "=%zu;" ECMC_PV_OPTION_BACKEND "=%s",
+           totalPvs, totalPvs, arraySize, backend);
+  long rssBefore = rssBytes();
+  parseConfigStr(config);
+  if(initPvs()) {
+    printf("Error: initPvs() failed.\n");
+    return 1;
+  }
+  long rssInit = rssBytes();
+
+  std::vector<int> scalarHandles, enumHandles, arrayHandles;
+  for(int i = 0; i < pvCount; ++i) {
+    scalarHandles.push_back(regPv(scalars[i].name.c_str(), BENCH_PROVIDER, ""));
+    enumHandles.push_back(regPv(enums[i].name.c_str(), BENCH_PROVIDER, ""));
+    arrayHandles.push_back(regPv(arrays[i].name.c_str(), BENCH_PROVIDER, ""));
+  }
+  std::vector<int> allHandles(scalarHandles);
+  allHandles.insert(allHandles.end(), enumHandles.begin(), enumHandles.end());
+  allHandles.insert(allHandles.end(), arrayHandles.begin(), arrayHandles.end());
+  for(size_t i = 0; i < allHandles.size(); ++i) {
+    if(allHandles[i] <= 0) {
+      printf("Error: regPv() failed (%d).\n", allHandles[i]);
+      return 1;
+    }
+  }
+
+  // Registering a registered pv again returns its handle (pool not used up)
+  int usedCount = getUsedPvCount();
+  for(int i = 0; i < BENCH_REREG_COUNT; ++i) {
+    int handle = regPv(scalars[0].name.c_str(), BENCH_PROVIDER, "");
+    if(handle != scalarHandles[0] || getUsedPvCount() != usedCount) {
+      printf("Error: Registration %d of %s returned %d (%d used pv objects, expected %d).\n",
+             i + 2, scalars[0].name.c_str(), handle, getUsedPvCount(), usedCount);
+      return 1;
+    }
+  }
+
+  // Wait for all connected
+  uint64_t connectStart = nowNs();
+  size_t connectedCount = 0;
+  while(connectedCount < allHandles.size()) {
+    connectedCount = 0;
+    for(size_t i = 0; i < allHandles.size(); ++i) {
+      connectedCount += getConnected(allHandles[i]) ? 1 : 0;
+    }
+    if(nowNs() - connectStart > 10000000000ull) {
+      printf("Error: Only %zu of %zu pvs connected.\n", connectedCount, allHandles.size());
+      return 1;
+    }
+    usleep(10000);
+  }
+  long rssConnected = rssBytes();
+  printf("Connected %zu pvs in %.1fms\n", allHandles.size(),
+         (nowNs() - connectStart) / 1e6);
+
+  // Server side updates (monitor events)
+  std::atomic<bool> stop(false);
+  std::thread updater([&]() {
+    double x = 0;
+    while(!stop.load()) {
+      updateServerPvs(scalars, arrays, arraySize, x);
+      x += 1;
+      usleep(1000);
+    }
+  });
+
+  // Simulated rt loop
+  long cycles = (long)(rate * seconds);
+  uint64_t periodNs = (uint64_t)(1e9 / rate);
+  std::vector<long> getSamples, putSamples, arraySamples, cycleSamples, jitterSamples;
+  getSamples.reserve(cycles * (2 * pvCount));
+  putSamples.reserve(cycles * (2 * pvCount));
+  arraySamples.reserve(cycles * pvCount);
+  cycleSamples.reserve(cycles);
+  jitterSamples.reserve(cycles);
+  std::vector<double> arrayData(arraySize);
+  long putOk = 0, putRejected = 0;
+
+  uint64_t cpuStart = cpuNs();
+  std::thread rt([&]() {
+    setRtPrio();
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    uint64_t expected = (uint64_t)next.tv_sec * 1000000000ull + next.tv_nsec;
+    for(long c = 0; c < cycles; ++c) {
+      expected += periodNs;
+      next.tv_sec  = expected / 1000000000ull;
+      next.tv_nsec = expected % 1000000000ull;
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+      uint64_t start = nowNs();
+      jitterSamples.push_back((long)(start - expected));
+
+      // Reads
+      for(int i = 0; i < pvCount; ++i) {
+        uint64_t t0 = nowNs();
+        volatile double v = getLastValue(scalarHandles[i]);
+        v = getLastValue(enumHandles[i]);
+        uint64_t t1 = nowNs();
+        (void)v;
+        getSamples.push_back((long)(t1 - t0) / 2);
+        t0 = nowNs();
+        getLastArray(arrayHandles[i], &arrayData[0], (int)arraySize);
+        t1 = nowNs();
+        arraySamples.push_back((long)(t1 - t0));
+      }
+
+      // Writes
+      if(mode == BENCH_PUT_BATCH) {
+        batchBegin();
+      }
+      for(int i = 0; i < pvCount; ++i) {
+        int handles[2] = {scalarHandles[i], enumHandles[i]};
+        double values[2] = {(double)c, (double)(c & 1)};
+        for(int j = 0; j < 2; ++j) {
+          uint64_t t0 = nowNs();
+          int error = mode == BENCH_PUT_LATEST ? exePutLatestCmd(handles[j], values[j])
+                                               : exePutDataCmd(handles[j], values[j]);
+          uint64_t t1 = nowNs();
+          putSamples.push_back((long)(t1 - t0));
+          if(error) {
+            putRejected++;
+          } else {
+            putOk++;
+          }
+        }
+      }
+      if(mode == BENCH_PUT_BATCH) {
+        batchCommit();
+      }
+      cycleSamples.push_back((long)(nowNs() - start));
+    }
+  });
+  rt.join();
+  stop = true;
+  updater.join();
+  uint64_t cpuUsed = cpuNs() - cpuStart;
+
+  // Report
+  double puts = 0, events = 0;
+  for(size_t i = 0; i < allHandles.size(); ++i) {
+    puts   += getStat(allHandles[i], ECMC_PV_STAT_PUT_COUNT);
+    events += getStat(allHandles[i], ECMC_PV_STAT_EVENT_COUNT);
+  }
+  printf("Mode %s, backend %s, %d pvs of each type, %.0fHz, %.1fs, array size %zu\n",
+         modeNames[mode], backend, pvCount, rate, seconds, arraySize);
+  report("pv_get", getSamples);
+  report("pv_get_array", arraySamples);
+  report("pv_put", putSamples);
+  report("rt cycle", cycleSamples);
+  report("rt jitter", jitterSamples);
+  printf("Puts accepted %ld, rejected %ld, issued %.0f (%.0f/s), monitor events %.0f (%.0f/s)\n",
+         putOk, putRejected, puts, puts / seconds, events, events / seconds);
+  printf("Memory: %.1fkB per pv object (preallocated), %.1fkB per connected pv\n",
+         (rssInit - rssBefore) / 1024.0 / totalPvs,
+         (rssConnected - rssInit) / 1024.0 / allHandles.size());
+  printf("Cpu: %.1fms total, %.1fus per monitor event (process incl. server)\n",
+         cpuUsed / 1e6, events > 0 ? cpuUsed / 1e3 / events : 0.0);
+
+  cleanup();
+  server.reset();
+  return 0;
+}
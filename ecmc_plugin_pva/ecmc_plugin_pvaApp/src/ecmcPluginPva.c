@@ -39,6 +39,30 @@ static int    loaded = 0;
 
 extern struct ecmcPluginData pluginDataDef;
 
+/** Export handles of pvs registered at construct (PV and PV_FILE options)
+ *  as plc consts, after the static consts.
+ **/
+static int addConfigPvConsts() {
+  int first = 0;
+  int count = getConfigPvCount();
+  int i = 0;
+  while(first < ECMC_PLUGIN_MAX_PLC_CONST_COUNT && pluginDataDef.consts[first].constName) {
+    first++;
+  }
+  // Keep last element zero
+  if(first + count >= ECMC_PLUGIN_MAX_PLC_CONST_COUNT) {
+    printf("%s/%s:%d: Error: Too many config pvs (%d, max %d).\n",__FILE__, __FUNCTION__,
+           __LINE__, count, ECMC_PLUGIN_MAX_PLC_CONST_COUNT - 1 - first);
+    return ECMC_PV_INIT_ERROR;
+  }
+  for(i = 0; i < count; ++i) {
+    pluginDataDef.consts[first + i].constName  = getConfigPvConstName(i);
+    pluginDataDef.consts[first + i].constDesc  = getConfigPvName(i);
+    pluginDataDef.consts[first + i].constValue = getConfigPvHandle(i);
+  }
+  return 0;
+}
+
 /** Optional. 
  *  Will be called once after successfull load into ecmc.
  *  Return value other than 0 will be considered error.
@@ -58,8 +82,19 @@ int pvaConstruct(char *configStr)
 
   // Add refs to generic funcs in runtime since objects
   pluginDataDef.funcs[0].funcGenericObj = getPvRegObj();  
+  pluginDataDef.funcs[8].funcGenericObj = getPvGetArrayObj();
+  pluginDataDef.funcs[9].funcGenericObj = getPvPutArrayObj();
   loaded = 1;
-  return initPvs();
+  int error = initPvs();
+  if(error) {
+    return error;
+  }
+  // Connect config pvs in parallel (no registration in plcs)
+  error = regConfigPvs();
+  if(error) {
+    return error;
+  }
+  return addConfigPvConsts();
 }
 
 /** Optional function.
@@ -82,6 +117,10 @@ void pvaDestruct(void)
 int pvaRealtime(int ecmcError)
 { 
   lastEcmcError = ecmcError;
+  // Flush batch left open by a plc (pv_batch_begin() without commit)
+  batchCommit();
+  // Values used by plcs in this cycle (if SNAPSHOT=1)
+  snapshotPvs();
   return 0;
 }
 
@@ -89,7 +128,8 @@ int pvaRealtime(int ecmcError)
  *  (for example ecmc PLC variables are defined only at enter of realtime)
  **/
 int pvaEnterRT(){
-  return 0;
+  // Wait for config pvs (CONNECT_TIMEOUT) and print startup report
+  return waitConfigPvs();
 }
 
 /** Optional function.
@@ -105,10 +145,72 @@ int pvaExitRT(void){
 //   return (double)exeGetDataCmd((int)handle);
 // }
 
+double pvaUnreg(double handle) {
+  return (double)unregPv((int)handle);
+}
+
 double pvaExePutCmd(double handle, double value) {
   return (double)exePutDataCmd((int)handle, value);
 }
 
+// Plc values are doubles: integers exact up to 2^53. Clamped as
+// ecmcPv::valueToInt64() (cast of NaN or out of range is undefined)
+double pvaExePutInt64Cmd(double handle, double value) {
+  int64_t data;
+  if(!(value > (double)INT64_MIN)) {  // Also NaN
+    data = INT64_MIN;
+  } else if(value >= (double)INT64_MAX) {
+    data = INT64_MAX;
+  } else {
+    data = (int64_t)value;
+  }
+  return (double)exePutInt64Cmd((int)handle, data);
+}
+
+double pvaGetLastValueInt64(double handle) {
+  int64_t value = 0;
+  if(getLastValueInt64((int)handle, &value)) {
+    return 0;
+  }
+  return (double)value;
+}
+
+double pvaGetSeverity(double handle) {
+  return (double)getSeverity((int)handle);
+}
+
+double pvaGetAge(double handle) {
+  return (double)getAgeNs((int)handle);
+}
+
+double pvaGetUpdates(double handle) {
+  return (double)getUpdateCount((int)handle);
+}
+
+double pvaExePutLatestCmd(double handle, double value) {
+  return (double)exePutLatestCmd((int)handle, value);
+}
+
+double pvaGetPutCoalesced(double handle) {
+  return (double)getPutCoalescedCount((int)handle);
+}
+
+double pvaBatchBegin() {
+  return (double)batchBegin();
+}
+
+double pvaBatchCommit() {
+  return (double)batchCommit();
+}
+
+double pvaGetStat(double handle, double stat) {
+  return getStat((int)handle, (int)stat);
+}
+
+double pvaResetStats(double handle) {
+  return (double)resetStats((int)handle);
+}
+
 double pvaGetLastValue(double handle) {
   return getLastValue((int)handle);
 }
@@ -121,6 +223,14 @@ double pvaGetConnected(double handle) {
   return getConnected((int)handle);
 }
 
+double pvaGetState(double handle) {
+  return (double)getState((int)handle);
+}
+
+double pvaGetStale(double handle) {
+  return (double)getStale((int)handle);
+}
+
 double pvaGetErr(double handle) {
   return (double)getError((int)handle);
 }
@@ -144,7 +254,19 @@ struct ecmcPluginData pluginDataDef = {
   // Description
   .desc = "Pva plugin for use with ecmc. Funcs: pvAccess, ioc status.",
   // Option description
-  .optionDesc = ECMC_PV_OPTION_MAX_PV_COUNT"=<count> : Set max number of pvs to connect to (defaults to 8).",
+  .optionDesc = ECMC_PV_OPTION_MAX_PV_COUNT"=<count> : Set max number of pvs to connect to (defaults to 8).\n"
+                ECMC_PV_OPTION_INIT_PV_COUNT"=<count> : Pv objects allocated at load, more allocated in chunks when needed (defaults to 8).\n"
+                ECMC_PV_OPTION_WORKER_THREADS"=<count> : Set number of shared worker threads for async cmds (defaults to 2).\n"
+                ECMC_PV_OPTION_MAX_ARRAY_SIZE"=<count> : Set max number of elements of array pvs (defaults to 1024).\n"
+                ECMC_PV_OPTION_SNAPSHOT"=<1/0> : Take values of all pvs at start of each rt cycle (defaults to 0).\n"
+                ECMC_PV_OPTION_ALARM_TIMESTAMP"=<1/0> : Request alarm and timeStamp with the value, see pv_severity() and pv_age() (defaults to 0).\n"
+                ECMC_PV_OPTION_BACKEND"=<" ECMC_PV_BACKEND_NAME_PVACLIENT "/" ECMC_PV_BACKEND_NAME_PVAC "> : Client api of channels (defaults to " ECMC_PV_BACKEND_NAME_PVACLIENT ").\n"
+                ECMC_PV_OPTION_PV"=<const name>,<pv name>[,<provider name>] : Register pv at load, handle as plc const (repeat for more pvs).\n"
+                ECMC_PV_OPTION_PV_FILE"=<file> : Register pvs of file at load, one \"<const name> <pv name> [<provider name> [<pv options>]]\" per line.\n"
+                ECMC_PV_OPTION_CONNECT_TIMEOUT"=<s> : Max time to wait for pvs of PV/PV_FILE at enter of realtime (defaults to 5).\n"
+                ECMC_PV_OPTION_RECONNECT_DELAY"=<s> : First retry delay of failed channels, doubled per failure (defaults to 1, 0: no retry).\n"
+                ECMC_PV_OPTION_RECONNECT_DELAY_MAX"=<s> : Max retry delay of failed channels (defaults to 30).\n"
+                ECMC_PV_OPTION_SERVE_LAST"=<1/0> : Return last value while reconnecting, see pv_stale() (defaults to 0).",
   // Plugin version
   .version = ECMC_EXAMPLE_PLUGIN_VERSION,
   // Optional construct func, called once at load. NULL if not definded.
@@ -161,7 +283,7 @@ struct ecmcPluginData pluginDataDef = {
   .funcs[0] =
       { /*----pv_reg_async----*/
         .funcName = ECMC_PV_PLC_CMD_PV_REG_ASYN,
-        .funcDesc = "handle = " ECMC_PV_PLC_CMD_PV_REG_ASYN "(<pv name>, <provider name pva/ca>) : register new pv.",
+        .funcDesc = "handle = " ECMC_PV_PLC_CMD_PV_REG_ASYN "(<pv name>, <provider name pva/ca>, <options (optional)>) : register new pv. A registered pv returns its handle (" ECMC_PV_REG_OPTION_SHARE "=1: own handle on the channel). Options: " ECMC_PV_REG_OPTION_QUEUE_SIZE "=, " ECMC_PV_REG_OPTION_PIPELINE "=, " ECMC_PV_REG_OPTION_FIELDS "=, " ECMC_PV_REG_OPTION_DEADBAND "=, " ECMC_PV_REG_OPTION_DEADBAND_REL "=, " ECMC_PV_REG_OPTION_DRAIN_LAST "=, " ECMC_PV_REG_OPTION_READ_ONLY "=, " ECMC_PV_REG_OPTION_BACKEND "=, " ECMC_PV_REG_OPTION_SHARE "=.",
         .funcArg0 = NULL,
         .funcArg1 = NULL,
         .funcArg2 = NULL,
@@ -295,8 +417,395 @@ struct ecmcPluginData pluginDataDef = {
         .funcArg10 = NULL,
         .funcGenericObj = NULL,
       },
-  .funcs[8]  = {0}, // last element set all to zero..
-  .consts[0] = {0}, // last element set all to zero..
+  .funcs[8] =
+      { /*----pv_get_array----*/
+        .funcName = ECMC_PV_PLC_CMD_PV_GET_ARRAY,
+        .funcDesc = "count = " ECMC_PV_PLC_CMD_PV_GET_ARRAY "(<handle>, <vector>) : Copy array of registerd pv to vector (updated by monitor). Returns element count or -error.",
+        .funcArg0 = NULL,
+        .funcArg1 = NULL,
+        .funcArg2 = NULL,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,  //will be assigned here during plugin construct (cannot initiate with non-const)
+      },
+  .funcs[9] =
+      { /*----pv_put_array----*/
+        .funcName = ECMC_PV_PLC_CMD_PV_PUT_ARRAY,
+        .funcDesc = "error = " ECMC_PV_PLC_CMD_PV_PUT_ARRAY "(<handle>, <vector>, <count (optional)>) : Execute async array put cmd.",
+        .funcArg0 = NULL,
+        .funcArg1 = NULL,
+        .funcArg2 = NULL,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,  //will be assigned here during plugin construct (cannot initiate with non-const)
+      },
+  .funcs[10] =
+      { /*----pv_put_latest----*/
+        .funcName = ECMC_PV_PLC_CMD_PV_PUT_LATEST,
+        .funcDesc = "error = " ECMC_PV_PLC_CMD_PV_PUT_LATEST "(<handle>, <value>) : Write value async, latest value wins (never busy).",
+        .funcArg0 = NULL,
+        .funcArg1 = NULL,
+        .funcArg2 = pvaExePutLatestCmd,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[11] =
+      { /*----pv_put_coalesced----*/
+        .funcName = ECMC_PV_PLC_CMD_PV_PUT_COALESCED,
+        .funcDesc = "count = " ECMC_PV_PLC_CMD_PV_PUT_COALESCED "(<handle>) : Get number of " ECMC_PV_PLC_CMD_PV_PUT_LATEST "() values overwritten before sent.",
+        .funcArg0 = NULL,
+        .funcArg1 = pvaGetPutCoalesced,
+        .funcArg2 = NULL,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[12] =
+      { /*----pv_batch_begin----*/
+        .funcName = ECMC_PV_PLC_CMD_PV_BATCH_BEGIN,
+        .funcDesc = "error = " ECMC_PV_PLC_CMD_PV_BATCH_BEGIN "() : Start batch. Async cmds are queued until " ECMC_PV_PLC_CMD_PV_BATCH_COMMIT "().",
+        .funcArg0 = pvaBatchBegin,
+        .funcArg1 = NULL,
+        .funcArg2 = NULL,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[13] =
+      { /*----pv_batch_commit----*/
+        .funcName = ECMC_PV_PLC_CMD_PV_BATCH_COMMIT,
+        .funcDesc = "count = " ECMC_PV_PLC_CMD_PV_BATCH_COMMIT "() : Hand all async cmds of batch to workers at once. Returns number of cmds or -error.",
+        .funcArg0 = pvaBatchCommit,
+        .funcArg1 = NULL,
+        .funcArg2 = NULL,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[14] =
+      { /*----pv_stat----*/
+        .funcName = ECMC_PV_PLC_CMD_PV_STAT,
+        .funcDesc = "value = " ECMC_PV_PLC_CMD_PV_STAT "(<handle>, <stat>) : Get statistics of pv (stat: use pv_stat_* consts).",
+        .funcArg0 = NULL,
+        .funcArg1 = NULL,
+        .funcArg2 = pvaGetStat,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[15] =
+      { /*----pv_stat_reset----*/
+        .funcName = ECMC_PV_PLC_CMD_PV_STAT_RESET,
+        .funcDesc = "error = " ECMC_PV_PLC_CMD_PV_STAT_RESET "(<handle>) : Reset statistics of pv.",
+        .funcArg0 = NULL,
+        .funcArg1 = pvaResetStats,
+        .funcArg2 = NULL,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[16] =
+      { /*----pv_get_int64----*/
+        .funcName = ECMC_PV_PLC_CMD_PV_GET_INT64,
+        .funcDesc = "value = " ECMC_PV_PLC_CMD_PV_GET_INT64 "(<handle>) : Get value of registerd integer pv without conversion via double (exact up to 2^53 in plc).",
+        .funcArg0 = NULL,
+        .funcArg1 = pvaGetLastValueInt64,
+        .funcArg2 = NULL,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[17] =
+      { /*----pv_put_int64----*/
+        .funcName = ECMC_PV_PLC_CMD_PV_PUT_INT64,
+        .funcDesc = "error = " ECMC_PV_PLC_CMD_PV_PUT_INT64 "(<handle>, <value>) : Execute async integer put (value truncated, written without conversion via double).",
+        .funcArg0 = NULL,
+        .funcArg1 = NULL,
+        .funcArg2 = pvaExePutInt64Cmd,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[18] =
+      { /*----pv_severity----*/
+        .funcName = ECMC_PV_PLC_CMD_PV_GET_SEVERITY,
+        .funcDesc = "severity = " ECMC_PV_PLC_CMD_PV_GET_SEVERITY "(<handle>) : Get alarm severity of value (ALARM_TIMESTAMP=1). 3 (INVALID) if no valid value.",
+        .funcArg0 = NULL,
+        .funcArg1 = pvaGetSeverity,
+        .funcArg2 = NULL,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[19] =
+      { /*----pv_age----*/
+        .funcName = ECMC_PV_PLC_CMD_PV_GET_AGE,
+        .funcDesc = "age = " ECMC_PV_PLC_CMD_PV_GET_AGE "(<handle>) : Get age of value [ns] (from timeStamp if ALARM_TIMESTAMP=1, else from monitor event).",
+        .funcArg0 = NULL,
+        .funcArg1 = pvaGetAge,
+        .funcArg2 = NULL,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[20] =
+      { /*----pv_updates----*/
+        .funcName = ECMC_PV_PLC_CMD_PV_GET_UPDATES,
+        .funcDesc = "count = " ECMC_PV_PLC_CMD_PV_GET_UPDATES "(<handle>) : Get number of values received by monitor.",
+        .funcArg0 = NULL,
+        .funcArg1 = pvaGetUpdates,
+        .funcArg2 = NULL,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[21] =
+      { /*----pv_unreg_asyn----*/
+        .funcName = ECMC_PV_PLC_CMD_PV_UNREG_ASYN,
+        .funcDesc = "error = " ECMC_PV_PLC_CMD_PV_UNREG_ASYN "(<handle>) : Unregister pv (async). Channel destroyed by worker, handle invalid after call.",
+        .funcArg0 = NULL,
+        .funcArg1 = pvaUnreg,
+        .funcArg2 = NULL,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[22] =
+      { /*----pv_state----*/
+        .funcName = ECMC_PV_PLC_CMD_PV_GET_STATE,
+        .funcDesc = "state = " ECMC_PV_PLC_CMD_PV_GET_STATE "(<handle>) : Get connection state of pv (use pv_state_* consts). pv_connected() is state pv_state_typed.",
+        .funcArg0 = NULL,
+        .funcArg1 = pvaGetState,
+        .funcArg2 = NULL,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[23] =
+      { /*----pv_stale----*/
+        .funcName = ECMC_PV_PLC_CMD_PV_GET_STALE,
+        .funcDesc = "stale = " ECMC_PV_PLC_CMD_PV_GET_STALE "(<handle>) : Returns 1 if the pv is reconnecting and its last value is kept (returned by pv_get() if SERVE_LAST=1).",
+        .funcArg0 = NULL,
+        .funcArg1 = pvaGetStale,
+        .funcArg2 = NULL,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[24] = {0}, // last element set all to zero..
+  .consts[0] = {
+        .constName = "pv_stat_put_count",
+        .constDesc = "Number of puts issued.",
+        .constValue = ECMC_PV_STAT_PUT_COUNT
+      },
+  .consts[1] = {
+        .constName = "pv_stat_put_lat_avg",
+        .constDesc = "Average put issue to putDone latency [us].",
+        .constValue = ECMC_PV_STAT_PUT_LATENCY_AVG
+      },
+  .consts[2] = {
+        .constName = "pv_stat_put_lat_max",
+        .constDesc = "Max put issue to putDone latency [us].",
+        .constValue = ECMC_PV_STAT_PUT_LATENCY_MAX
+      },
+  .consts[3] = {
+        .constName = "pv_stat_evt_count",
+        .constDesc = "Number of monitor events.",
+        .constValue = ECMC_PV_STAT_EVENT_COUNT
+      },
+  .consts[4] = {
+        .constName = "pv_stat_evt_rate",
+        .constDesc = "Monitor event rate [Hz].",
+        .constValue = ECMC_PV_STAT_EVENT_RATE
+      },
+  .consts[5] = {
+        .constName = "pv_stat_vis_lat_avg",
+        .constDesc = "Average monitor event to pv_get() latency [us].",
+        .constValue = ECMC_PV_STAT_VISIBLE_LATENCY_AVG
+      },
+  .consts[6] = {
+        .constName = "pv_stat_vis_lat_max",
+        .constDesc = "Max monitor event to pv_get() latency [us].",
+        .constValue = ECMC_PV_STAT_VISIBLE_LATENCY_MAX
+      },
+  .consts[7] = {
+        .constName = "pv_stat_coalesced",
+        .constDesc = "Number of pv_put_latest() values overwritten before sent.",
+        .constValue = ECMC_PV_STAT_COALESCED_COUNT
+      },
+  .consts[8] = {
+        .constName = "pv_stat_overruns",
+        .constDesc = "Number of monitor overruns.",
+        .constValue = ECMC_PV_STAT_OVERRUN_COUNT
+      },
+  .consts[9] = {
+        .constName = "pv_stat_busy",
+        .constDesc = "Number of async cmds rejected since busy.",
+        .constValue = ECMC_PV_STAT_BUSY_COUNT
+      },
+  .consts[10] = {
+        .constName = "pv_stat_reconnects",
+        .constDesc = "Number of reconnects.",
+        .constValue = ECMC_PV_STAT_RECONNECT_COUNT
+      },
+  .consts[11] = {
+        .constName = "pv_stat_filtered",
+        .constDesc = "Number of monitor values dropped by deadband (pv_reg_asyn() options).",
+        .constValue = ECMC_PV_STAT_FILTERED_COUNT
+      },
+  .consts[12] = {
+        .constName = "pv_stat_queue_max",
+        .constDesc = "Max number of monitor elements drained in one monitor event (queue depth).",
+        .constValue = ECMC_PV_STAT_QUEUE_DEPTH_MAX
+      },
+  .consts[13] = {
+        .constName = "pv_stat_skipped",
+        .constDesc = "Number of monitor elements skipped (pv_reg_asyn() option DRAIN_LAST).",
+        .constValue = ECMC_PV_STAT_SKIPPED_COUNT
+      },
+  .consts[14] = {
+        .constName = "pv_state_unregistered",
+        .constDesc = "Free handle or unregistered pv.",
+        .constValue = ECMC_PV_STATE_UNREGISTERED
+      },
+  .consts[15] = {
+        .constName = "pv_state_registering",
+        .constDesc = "Register cmd queued.",
+        .constValue = ECMC_PV_STATE_REGISTERING
+      },
+  .consts[16] = {
+        .constName = "pv_state_connecting",
+        .constDesc = "Channel created, not connected yet.",
+        .constValue = ECMC_PV_STATE_CONNECTING
+      },
+  .consts[17] = {
+        .constName = "pv_state_connected",
+        .constDesc = "Channel connected, no monitor data yet.",
+        .constValue = ECMC_PV_STATE_CONNECTED
+      },
+  .consts[18] = {
+        .constName = "pv_state_typed",
+        .constDesc = "Monitor data of supported type received (pv_connected()).",
+        .constValue = ECMC_PV_STATE_TYPED
+      },
+  .consts[19] = {
+        .constName = "pv_state_disconnected",
+        .constDesc = "Connection lost (reconnected automatically).",
+        .constValue = ECMC_PV_STATE_DISCONNECTED
+      },
+  .consts[20] = {
+        .constName = "pv_state_error",
+        .constDesc = "Register failed, monitor failed or type not supported.",
+        .constValue = ECMC_PV_STATE_ERROR
+      },
+  .consts[21] = {
+        .constName = "pv_stat_fast_reconn",
+        .constDesc = "Number of reconnects with cached type (not validated again).",
+        .constValue = ECMC_PV_STAT_FAST_RECONNECT_COUNT
+      },
+  .consts[22] = {
+        .constName = "pv_stat_retries",
+        .constDesc = "Number of failed channels recreated (RECONNECT_DELAY).",
+        .constValue = ECMC_PV_STAT_RETRY_COUNT
+      },
+  .consts[23] = {0}, // last element set all to zero..
 };
 
 ecmc_plugin_register(pluginDataDef);
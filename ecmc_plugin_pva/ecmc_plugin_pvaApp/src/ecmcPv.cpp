@@ -11,61 +11,179 @@
 *  Pv access support for ecmc:
 *  * pv_reg_asyn()  : async command to register a pv
 *  * pv_put_asyn()  : async command to write to a pv
+*  * pv_put_latest(): write, latest value wins (coalesced)
 *  * pv_get_value() : return last value (from monitor)
-*  The async commands are executed in a worker thread. This was needed
-*  since even the "issue*()" commands was found to block for to 
-*  long time. 
+*  The async commands are executed by a shared pool of worker threads
+*  (ecmcPvCmdDispatcher). This was needed since even the "issue*()"
+*  commands was found to block for to long time. 
 *
 *  Implementation is based on examples found in:
 *  https://github.com/epics-base/exampleCPP.git 
 *
 \*************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <stdexcept>
+#include <pv/typeCast.h>
+#include <pv/pvData.h>
+#include "epicsTime.h"
 #include "ecmcPv.h"
 
-// Start worker threads for each object
-void f_cmd_exe(void *obj) {
-  if(!obj) {
-    printf("%s/%s:%d: Error: Worker thread PV object NULL..\n",
-            __FILE__, __FUNCTION__, __LINE__);
-    return;
+// Reference to monitored array in native element type (no copy, no conversion).
+// Shared vectors are copy on write so the data stays valid after the monitor
+// element is released and reused.
+template <typename T>
+static shared_vector<const void> viewArrayAs(const PVScalarArray *pvArray) {
+  return static_shared_vector_cast<const void>(
+           static_cast<const PVValueArray<T>*>(pvArray)->view());
+}
+
+// Write array to put structure, reusing the storage of the field
+template <typename T>
+static void putArrayAs(PVScalarArrayPtr const &pvArray, const double *data, size_t count) {
+  typename PVValueArray<T>::shared_pointer typed =
+      std::tr1::static_pointer_cast<PVValueArray<T> >(pvArray);
+  typename PVValueArray<T>::svector buffer(typed->reuse());
+  buffer.resize(count);  // No allocation if capacity is enough
+  castUnsafeV(count, (ScalarType)ScalarTypeID<T>::value, buffer.data(), pvDouble, data);
+  typed->replace(freeze(buffer));
+}
+
+// Read monitored scalar in native type (selected once by getScalarFunc())
+template <typename T>
+static void getScalarAsInt64(PVScalar *pvScalar, ecmcPvValue *value) {
+  value->i = (int64_t)static_cast<PVScalarValue<T>*>(pvScalar)->get();
+}
+
+template <typename T>
+static void getScalarAsDouble(PVScalar *pvScalar, ecmcPvValue *value) {
+  value->d = (double)static_cast<PVScalarValue<T>*>(pvScalar)->get();
+}
+
+static void getScalarAsUInt64(PVScalar *pvScalar, ecmcPvValue *value) {
+  value->u = static_cast<PVScalarValue<uint64>*>(pvScalar)->get();
+}
+
+static ecmcPvGetScalarFunc getScalarFunc(ScalarType type, ecmc_pv_value_kind *kind) {
+  *kind = ECMC_PV_VALUE_INT64;
+  switch(type) {
+    case pvBoolean: return &getScalarAsInt64<boolean>;
+    case pvByte:    return &getScalarAsInt64<int8>;
+    case pvShort:   return &getScalarAsInt64<int16>;
+    case pvInt:     return &getScalarAsInt64<int32>;
+    case pvLong:    return &getScalarAsInt64<int64>;
+    case pvUByte:   return &getScalarAsInt64<uint8>;
+    case pvUShort:  return &getScalarAsInt64<uint16>;
+    case pvUInt:    return &getScalarAsInt64<uint32>;
+    case pvULong:
+      *kind = ECMC_PV_VALUE_UINT64;
+      return &getScalarAsUInt64;
+    case pvFloat:
+      *kind = ECMC_PV_VALUE_DOUBLE;
+      return &getScalarAsDouble<float>;
+    case pvDouble:
+      *kind = ECMC_PV_VALUE_DOUBLE;
+      return &getScalarAsDouble<double>;
+    default:
+      return NULL;
   }
+}
 
-  ecmcPv * pvObj = (ecmcPv*)obj;
-  pvObj->exeCmdThread();
+// Parsed request (pvac backend), throws if invalid
+static PVStructurePtr createPvRequest(const std::string &request) {
+  PVStructurePtr pvRequest = CreateRequest::create()->createRequest(request);
+  if(!pvRequest) {
+    throw std::runtime_error("Invalid request \"" + request + "\"");
+  }
+  return pvRequest;
 }
 
 ecmcPv::ecmcPv(const std::string &channelName,
                const std::string &providerName,
                const std::string &request, 
-               int index):
+               int index,
+               ecmcPvCmdDispatcher *dispatcher,
+               size_t maxArraySize,
+               ecmcPvHotTable *hotTable):
       channelName_(channelName),
       providerName_(providerName),
       request_(request),
-      channelConnected_(false),
-      monitorConnected_(false),
       putConnected_(false),
       isStarted_(false),
-      typeValidated_(false),
-      destructs_(false),
-      inUse_(false),
+      channelState_(ECMC_PV_STATE_UNREGISTERED),
+      released_(false),
+      source_(this),
+      channelRefs_(0),
+      destroyChannel_(false),
+      readOnly_(false),
+      backend_(ECMC_PV_BACKEND_PVACLIENT),
       index_(index),
       errorCode_(0), 
-      valueLatestRead_(0),
-      valueToWrite_(0),      
+      hot_(hotTable),
+      snapshotMode_(false),
+      snapshotCycle_(0),
+      valueToWrite_(),      
+      valueToWriteKind_(ECMC_PV_VALUE_DOUBLE),
+      valueKind_(ECMC_PV_VALUE_DOUBLE),
+      getScalarFunc_(NULL),
       type_(scalar),
-      cmd_(ECMC_PV_CMD_NONE)
+      cmd_(ECMC_PV_CMD_NONE),
+      sharersMutex_(NULL),
+      sharers_(NULL),
+      nextSharer_(NULL),
+      putStructure_(NULL),
+      putStagedKind_(ECMC_PV_VALUE_DOUBLE),
+      putStagedArray_(false),
+      monUpdateCount_(0),
+      monLastValue_(),
+      overrunReported_(0),
+      dispatcher_(dispatcher),
+      maxArraySize_(maxArraySize),
+      arrayElementType_(pvDouble),
+      arrayBuffer_(NULL),
+      arrayToWrite_(NULL),
+      arrayToWriteCount_(0),
+      arrayTruncatedCount_(0),
+      putLatestValue_(0),
+      putLatestPending_(false),
+      putLatestInFlight_(false),
+      putCmdInFlight_(false),
+      putConnectPending_(false),
+      putWaitingCmd_(ECMC_PV_CMD_NONE),
+      putIssueNs_(0),
+      everConnected_(false),
+      retryAtNs_(0),
+      retryDelayS_(0)
 {
-  busyLock_.test_and_set();
+  for(int i = 0; i < ECMC_PV_RT_OP_COUNT; ++i) {
+    rtErrors_[i].errorCode = 0;
+    rtErrors_[i].count = 0;
+    rtErrors_[i].countReported = 0;
+  }
+  memset(&monFields_, 0, sizeof(monFields_));
+  clearElementFields();
+  typedStructure_.reset();
+  memset(&monOptions_, 0, sizeof(monOptions_));
+  memset(&putStaged_, 0, sizeof(putStaged_));
 }
 
  void ecmcPv::init() {
- 
-  // Create worker thread
-  std::string threadname = "ecmc.cmd.pv"  + to_string(index_);
-  cmdExeThread_ = epicsThreadCreate(threadname.c_str(), 0, 32768, f_cmd_exe, this);
-  if( cmdExeThread_ == NULL) {
-     throw std::runtime_error("Error: Failed cmd exe worker thread.");
-  } 
+
+  if(!dispatcher_) {
+    throw std::runtime_error("Error: Cmd dispatcher NULL.");
+  }
+  if(!hot_ || index_ < 1 || index_ > hot_->getCount()) {
+    throw std::runtime_error("Error: Hot table NULL or index out of range.");
+  }
+  hot_->setVisibleLatency(index_ - 1, &stats_.visibleLatency);
+
+  sharersMutex_ = epicsMutexCreate();
+  if(!sharersMutex_) {
+    throw std::runtime_error("Error: Create mutex failed.");
+  }
 }
 
 ecmcPv::ecmcPv() {
@@ -74,9 +192,13 @@ ecmcPv::ecmcPv() {
 ecmcPvPtr ecmcPv::create(const std::string  & channelName, 
                          const std::string  & providerName,
                          const std::string  & request,
-                         int index)
+                         int index,
+                         ecmcPvCmdDispatcher *dispatcher,
+                         size_t maxArraySize,
+                         ecmcPvHotTable *hotTable)
 {
-  ecmcPvPtr client(ecmcPvPtr(new ecmcPv(channelName, providerName, request, index)));
+  ecmcPvPtr client(ecmcPvPtr(new ecmcPv(channelName, providerName, request, index,
+                                        dispatcher, maxArraySize, hotTable)));
   client->init();
   return client;
 }
@@ -84,9 +206,14 @@ ecmcPvPtr ecmcPv::create(const std::string  & channelName,
 void ecmcPv::monitorConnect(epics::pvData::Status const & status,
     PvaClientMonitorPtr const & monitor, epics::pvData::StructureConstPtr const & structure)
 {
-  cout << "monitorConnect " << channelName_ << " status " << status << endl;
-  if(!status.isOK()) return;
-  monitorConnected_ = true;
+  if(!status.isOK()) {
+    epicsMutexLock(sharersMutex_);
+    channelFailed();
+    epicsMutexUnlock(sharersMutex_);
+    log(ECMC_PV_LOG_ERROR, "Monitor connect failed: %s", status.getMessage().c_str());
+    return;
+  }
+  log(ECMC_PV_LOG_INFO, "Monitor connected");
   if(isStarted_) return;
   isStarted_ = true;
   pvaClientMonitor_->start();
@@ -94,61 +221,482 @@ void ecmcPv::monitorConnect(epics::pvData::Status const & status,
 
 void ecmcPv::event(PvaClientMonitorPtr const & monitor)
 {
-// cout << "event " << channelName_ << endl;
+  ecmcPvEventDrain drain = ecmcPvEventDrain();
+
   while(monitor->poll()) {
+    // All handles unregistered (monitor about to be destroyed)
+    if(channelRefs_.load() == 0) {
+      monitor->releaseEvent();
+      continue;
+    }
     PvaClientMonitorDataPtr monitorData = monitor->getData();
-//     cout << "monitor " << endl;
-//     cout << "changed\n";
-//     monitorData->showChanged(cout);
-//     cout << "overrun\n";
-//     monitorData->showOverrun(cout);
-    if(!typeValidated_) {
-      typeValidated_ = validateType(monitorData);
-      if(!typeValidated_) {
-        cout << "Type not supported";
-        errorCode_ = ECMC_PV_TYPE_NOT_SUPPORTED;
-        return;
-      }
-    }   
+    countElement(&drain, !monitorData->getOverrunBitSet()->isEmpty());
+    if(monOptions_.drainLast) {
+      // Element reused after release: merge it, decoded once when drained
+      stageElement(monitorData->getPVStructure(), *monitorData->getChangedBitSet());
+      monitor->releaseEvent();
+      continue;
+    }
+    int error = publishElement(monitorData->getPVStructure());
     monitor->releaseEvent();
-    epicsMutexLock(ecmcGetValMutex_);
-    valueLatestRead_ = getDouble(monitorData);
-    epicsMutexUnlock(ecmcGetValMutex_);    
+    if(error == ECMC_PV_TYPE_NOT_SUPPORTED) {
+      return;
+    }
+  }
+  finishDrain(&drain, drainRoot_);
+}
+
+// pvac backend: pva thread, same decoding as event()
+void ecmcPv::monitorEvent(const pvac::MonitorEvent &evt) {
+  switch(evt.event) {
+    case pvac::MonitorEvent::Data:
+      break;
+    case pvac::MonitorEvent::Fail:
+      epicsMutexLock(sharersMutex_);
+      channelFailed();
+      epicsMutexUnlock(sharersMutex_);
+      errorCode_ = ECMC_PV_MON_ERROR;
+      log(ECMC_PV_LOG_ERROR, "Monitor failed: %s", evt.message.c_str());
+      return;
+    default:
+      // Disconnect (see connectEvent()) or cancel (see destroyChannel())
+      return;
+  }
+
+  ecmcPvEventDrain drain = ecmcPvEventDrain();
+  while(pvacMonitor_.poll()) {
+    // All handles unregistered (monitor about to be cancelled)
+    if(channelRefs_.load() == 0) {
+      continue;
+    }
+    countElement(&drain, !pvacMonitor_.overrun.isEmpty());
+    if(monOptions_.drainLast) {
+      continue;  // root merges all polled elements, decoded once when drained
+    }
+    if(publishElement(pvacMonitor_.root) == ECMC_PV_TYPE_NOT_SUPPORTED) {
+      return;
+    }
+  }
+  finishDrain(&drain, pvacMonitor_.root);
+}
+
+// Monitor thread: decode one monitor element. Arrays are referenced (the
+// immutable data stays valid after the element is released).
+int ecmcPv::decodeElement(const PVStructureConstPtr &pvStructure,
+                          ecmcPvValue *latest, shared_vector<const void> *array) {
+  latest->eventNs = epicsMonotonicGet();
+  // New introspection (first event, reconnect or changed server side). The
+  // type validated before is cached: an equal introspection (new instance
+  // after a reconnect, compared by value) keeps offsets and decoding.
+  const StructureConstPtr &structure = pvStructure->getStructure();
+  // Cache only valid with resolved offsets and decoding
+  if(typedStructure_ &&
+     (!monFields_.value || (type_ != scalarArray && !getScalarFunc_))) {
+    typedStructure_.reset();
+  }
+  if(structure.get() != monFields_.structure) {
+    clearElementFields();  // Resolved for other elements/offsets
+    if(typedStructure_ && *structure == *typedStructure_) {
+      monFields_.structure = structure.get();
+      typedStructure_ = structure;
+    } else {
+      resolveMonitorFields(pvStructure.get());
+    }
+  }
+  // First data after (re)connect: validated only if the type is not cached
+  bool validate = structure.get() != typedStructure_.get();
+  if(validate || channelState_.load() != ECMC_PV_STATE_TYPED) {
+    bool valid = true;
+    if(validate) {
+      valid = validateType(pvStructure.get()) != 0;
+      typedStructure_ = valid ? structure : StructureConstPtr();
+    } else {
+      ecmcPvStats::inc(stats_.fastReconnectCount);
+    }
+    epicsMutexLock(sharersMutex_);
+    // Not after disconnect (typed again at reconnect)
+    uint32_t state = channelState_.load();
+    if(state != ECMC_PV_STATE_DISCONNECTED && state != ECMC_PV_STATE_UNREGISTERED) {
+      updateChannelState(valid ? ECMC_PV_STATE_TYPED : ECMC_PV_STATE_ERROR);
+    }
+    if(valid) {
+      retryDelayS_ = 0;  // Backoff starts over at next failure
+    }
+    epicsMutexUnlock(sharersMutex_);
+    if(!valid) {
+      log(ECMC_PV_LOG_ERROR, "Type not supported");
+      errorCode_ = ECMC_PV_TYPE_NOT_SUPPORTED;
+      return errorCode_;
+    }
+  }
+  const ecmcPvElementFields &fields = elementFields(pvStructure);
+  getAlarmTimeStamp(fields, latest);
+  if(type_ == scalarArray) {
+    latest->kind = ECMC_PV_VALUE_ARRAY;
+    return viewArray(fields, array);
+  }
+  latest->kind = valueKind_;
+  return getValue(fields, latest);
+}
+
+// Monitor thread: typed fields of element, only resolved from the offsets
+// at the first event of the element (later events compare one pointer)
+const ecmcPvElementFields& ecmcPv::elementFields(const PVStructureConstPtr &pvStructure) {
+  for(size_t i = 0; i < ECMC_PV_ELEMENT_CACHE_SIZE; ++i) {
+    if(monElements_[i].element == pvStructure) {
+      return monElements_[i];
+    }
+  }
+  ecmcPvElementFields &fields = monElements_[monElementNext_];
+  monElementNext_ = (monElementNext_ + 1) % ECMC_PV_ELEMENT_CACHE_SIZE;
+  fields.element     = pvStructure;
+  fields.value       = NULL;
+  fields.array       = NULL;
+  fields.severity    = NULL;
+  fields.seconds     = NULL;
+  fields.nanoseconds = NULL;
+  if(monFields_.value) {
+    if(type_ == scalarArray) {
+      fields.array = pvStructure->getSubField<PVScalarArray>(monFields_.value).get();
+    } else {
+      fields.value = pvStructure->getSubField<PVScalar>(monFields_.value).get();
+    }
+  }
+  if(monFields_.severity) {
+    fields.severity = pvStructure->getSubField<PVInt>(monFields_.severity).get();
+  }
+  if(monFields_.seconds && monFields_.nanoseconds) {
+    fields.seconds = pvStructure->getSubField<PVLong>(monFields_.seconds).get();
+    fields.nanoseconds = pvStructure->getSubField<PVInt>(monFields_.nanoseconds).get();
+  }
+  return fields;
+}
+
+// Monitor thread (and worker when the channel is destroyed): release elements
+void ecmcPv::clearElementFields() {
+  for(size_t i = 0; i < ECMC_PV_ELEMENT_CACHE_SIZE; ++i) {
+    monElements_[i] = ecmcPvElementFields();
+  }
+  monElementNext_ = 0;
+}
+
+// Monitor thread: count polled element (DRAIN_LAST: only the last one is decoded)
+void ecmcPv::countElement(ecmcPvEventDrain *drain, bool overrun) {
+  ++drain->depth;
+  ecmcPvStats::inc(stats_.eventCount);
+  if(overrun) {
+    ecmcPvStats::inc(stats_.overrunCount);
+  }
+  if(monOptions_.drainLast) {
+    if(drain->staged) {
+      ecmcPvStats::inc(stats_.skippedCount);
+    }
+    drain->staged = true;
+  }
+}
+
+// Monitor thread (pvaClient, DRAIN_LAST): merge changed fields of element
+// into drainRoot_ (arrays referenced, not copied). Recreated when the
+// introspection changes.
+void ecmcPv::stageElement(const PVStructurePtr &pvStructure, const BitSet &changed) {
+  if(!drainRoot_ || drainRoot_->getStructure() != pvStructure->getStructure()) {
+    drainRoot_ = getPVDataCreate()->createPVStructure(pvStructure->getStructure());
+    drainRoot_->copyUnchecked(*pvStructure);
+    return;
+  }
+  drainRoot_->copyUnchecked(*pvStructure, changed);
+}
+
+// Monitor thread: decode and publish element
+int ecmcPv::publishElement(const PVStructureConstPtr &pvStructure) {
+  ecmcPvValue latest = ecmcPvValue();
+  shared_vector<const void> array;
+  int error = decodeElement(pvStructure, &latest, &array);
+  if(error) {
+    return error;
+  }
+  publish(latest, array);
+  return 0;
+}
+
+// Monitor thread: all queued elements polled (DRAIN_LAST: decode the last)
+void ecmcPv::finishDrain(ecmcPvEventDrain *drain, const PVStructureConstPtr &staged) {
+  if(drain->staged && staged) {
+    publishElement(staged);
+  }
+  ecmcPvStats::max(stats_.queueDepthMax, drain->depth);
+}
+
+// Monitor thread: publish to rt without locking (see ecmcPvSeqLock, ecmcPvArrayBuffer)
+void ecmcPv::publish(ecmcPvValue &latest, const shared_vector<const void> &array) {
+  if(type_ == scalarArray) {
+    // Only alarm/timeStamp in latest
+    if(publishArray(array)) {
+      return;
+    }
+  } else if(inDeadband(latest)) {
+    ecmcPvStats::inc(stats_.filteredCount);
+    return;
   }
+  latest.updateCount = ++monUpdateCount_;
+  hot_->value(index_ - 1).value.write(latest);
+  monLastValue_ = latest;
 }
 
 void ecmcPv::channelPutConnect (const epics::pvData::Status &status, PvaClientPutPtr const &clientPut)
 {
- // cout << "putConnect " << channelName_ << " status " << status << endl;
-  if(!status.isOK()) return;
+  if(!status.isOK()) {
+    log(ECMC_PV_LOG_ERROR, "Put connect failed: %s", status.getMessage().c_str());
+    putConnectPending_ = false;
+    failPutConnect();
+    return;
+  }
+  log(ECMC_PV_LOG_DEBUG, "Put connected");
+  resolvePutFields(clientPut->getData()->getPVStructure());
   putConnected_ = true;
-  busyLock_.clear();  
+  putConnectPending_ = false;
+  replayPutCmds();
 }
 
 void ecmcPv::putDone(const epics::pvData::Status & status,
                        PvaClientPutPtr const & clientPut) {
-  // put cmd done.. allow new
-  busyLock_.clear();
-  if(!status.isOK()){
+  putCompleted(status.isOK(), status.getMessage());
+}
+
+// pvac backend: pva thread
+void ecmcPv::putDone(const pvac::PutEvent &evt) {
+  if(evt.event == pvac::PutEvent::Cancel) {
+    return;  // Put destroyed (see destroyPut())
+  }
+  putCompleted(evt.event == pvac::PutEvent::Success, evt.message);
+}
+
+// pvac backend: pva thread, write the staged value to a structure of the
+// server put type (created once per type, reused by all puts and kept over
+// reconnects if the type is equal)
+void ecmcPv::putBuild(const StructureConstPtr &build,
+                      pvac::ClientChannel::PutCallback::Args &args) {
+  if(!pvacPutRoot_ || (pvacPutRoot_->getStructure().get() != build.get() &&
+                       !(*pvacPutRoot_->getStructure() == *build))) {
+    pvacPutRoot_ = getPVDataCreate()->createPVStructure(build);
+    resolvePutFields(pvacPutRoot_);
+  }
+  int error = putStagedArray_ ? writeArray() : writeValue();
+  if(error) {
+    // Reported as failed put (putDone())
+    throw std::runtime_error(errorToString(error));
+  }
+  PVFieldPtr field = putStagedArray_ ? PVFieldPtr(putArrayField_) : PVFieldPtr(putValueField_);
+  args.root = pvacPutRoot_;
+  args.tosend.set(field->getFieldOffset());
+}
+
+void ecmcPv::putCompleted(bool ok, const std::string &message) {
+  uint64_t issueNs = putIssueNs_.exchange(0, std::memory_order_relaxed);
+  if(issueNs) {
+    stats_.putLatency.add(epicsMonotonicGet() - issueNs);
+  }
+
+  if(!ok){
     errorCode_ = ECMC_PV_PUT_ERROR;   
+    log(ECMC_PV_LOG_ERROR, "Put failed: %s", message.c_str());
   }  
+
+  if(putCmdInFlight_.exchange(false)) {
+    // put cmd done.. allow new
+    hotState().clearBusy();
+  } else if(!putLatestInFlight_.exchange(false)) {
+    return;  // Put issued before a reconnect (see abortPutInFlight())
+  }
+
+  // Send put cmd or latest value deposited meanwhile (if any)
+  replayPutCmds();
+}
+
+// Pva thread: no putDone() from a put issued before disconnect
+void ecmcPv::abortPutInFlight() {
+  if(putCmdInFlight_.exchange(false)) {
+    hotState().clearBusy();
+  }
+  putLatestInFlight_ = false;
+  replayPutCmds();
 }
 
 void ecmcPv::channelStateChange(PvaClientChannelPtr const & channel, bool isConnected)
 {
-// cout << "channelStateChange " << channelName_ << " isConnected_ " << (isConnected ? "true" : "false") << endl;
-  channelConnected_ = isConnected;
+  // All handles unregistered (channel about to be destroyed)
+  if(channelRefs_.load() == 0) {
+    return;
+  }
+  // Channel released by a retry (see releaseChannel())
+  epicsMutexLock(sharersMutex_);
+  bool current = channel == pvaClientChannel_;
+  epicsMutexUnlock(sharersMutex_);
+  if(!current) {
+    return;
+  }
+  connectionChanged(isConnected);
+  if(isConnected && !pvaClientMonitor_) {
+    pvaClientMonitor_ = pvaClientChannel_->createMonitor(request_);
+    pvaClientMonitor_->setRequester(shared_from_this());
+    pvaClientMonitor_->issueConnect();
+  }
+}
+
+// pvac backend: pva thread (monitor started by pvac when connected)
+void ecmcPv::connectEvent(const pvac::ConnectEvent &evt) {
+  // All handles unregistered (channel about to be destroyed)
+  if(channelRefs_.load() == 0) {
+    return;
+  }
+  connectionChanged(evt.connected);
+}
+
+// Pva thread: channel (of source) connected or disconnected
+void ecmcPv::connectionChanged(bool isConnected) {
+  if(isConnected) {
+    if(everConnected_) {
+      ecmcPvStats::inc(stats_.reconnectCount);
+    }
+    everConnected_ = true;
+  }
+  log(ECMC_PV_LOG_INFO, isConnected ? "Channel connected" : "Channel disconnected");
+
+  // Puts are created on first put (see connectPut()) and are kept over
+  // reconnects (reconnected by pvAccess).
+  // Typed again at first data (only validated if the introspection changed,
+  // see decodeElement()). A reconnect passes disconnected, typed here means
+  // data came first (pvac).
+  epicsMutexLock(sharersMutex_);
+  if(!isConnected) {
+    updateChannelState(ECMC_PV_STATE_DISCONNECTED);
+  } else if(channelState_.load() != ECMC_PV_STATE_TYPED) {
+    updateChannelState(ECMC_PV_STATE_CONNECTED);
+  }
   if(isConnected) {
-    if(!pvaClientMonitor_) {
-      pvaClientMonitor_ = pvaClientChannel_->createMonitor(request_);
-      pvaClientMonitor_->setRequester(shared_from_this());
-      pvaClientMonitor_->issueConnect();
-    }      
-    pvaClientPut_ = pvaClientChannel_->createPut(request_);      
+    if(inUse()) {
+      abortPutInFlight();
+    }
+    for(ecmcPv *sharer = sharers_; sharer; sharer = sharer->nextSharer_) {
+      sharer->abortPutInFlight();
+    }
+  }
+  epicsMutexUnlock(sharersMutex_);
+}
+
+// Worker thread: create put of this handle on the (shared) channel at first
+// put. The put cmd is executed when connected (see channelPutConnect()).
+void ecmcPv::connectPut(ecmc_pva_cmd cmd) {
+  // NONE: pv_put_latest() (see putLatestPending_), must not replace a put cmd
+  if(cmd != ECMC_PV_CMD_NONE) {
+    putWaitingCmd_ = cmd;
+  }
+  if(putConnectPending_.exchange(true)) {
+    return;  // Already connecting
+  }
+  // Connected after exeCmd() checked
+  if(putConnected_) {
+    putConnectPending_ = false;
+    replayPutCmds();
+    return;
+  }
+
+  // pvac: nothing to connect (one put operation per put, see putBuild())
+  if(backend_ == ECMC_PV_BACKEND_PVAC) {
+    try{
+      pvacPutRequest_ = createPvRequest(ECMC_PV_PUT_REQUEST);
+      putConnected_ = true;
+      putConnectPending_ = false;
+      replayPutCmds();
+      return;
+    }
+    catch(std::exception &e){
+      log(ECMC_PV_LOG_ERROR, "Put create failed: %s", e.what());
+    }
+    putConnectPending_ = false;
+    failPutConnect();
+    return;
+  }
+
+  epicsMutexLock(source_->sharersMutex_);
+  PvaClientChannelPtr channel = source_->pvaClientChannel_;
+  epicsMutexUnlock(source_->sharersMutex_);
+  try{
+    if(!channel) {
+      throw std::runtime_error("Channel not created");
+    }
+    pvaClientPut_ = channel->createPut(ECMC_PV_PUT_REQUEST);
     pvaClientPut_->setRequester(shared_from_this());
     pvaClientPut_->issueConnect();
-    typeValidated_ = false;  //Could change after reconnect?!
+    return;
+  }
+  catch(std::exception &e){
+    log(ECMC_PV_LOG_ERROR, "Put create failed: %s", e.what());
+  }
+  putConnectPending_ = false;
+  failPutConnect();
+}
+
+// Put connected or done: execute the put cmd and the pv_put_latest() value
+// that waited for it. The latest value follows the put cmd (see putCompleted()).
+void ecmcPv::replayPutCmds() {
+  ecmc_pva_cmd cmd = putWaitingCmd_.exchange(ECMC_PV_CMD_NONE);
+  if(cmd != ECMC_PV_CMD_NONE) {
+    cmd_ = cmd;  // Handle busy, no other cmd can be written
+    if(dispatcher_->schedule(this)) {
+      errorCode_ = ECMC_PV_PUT_ERROR;
+      hotState().clearBusy();
+      putLatestPending_ = false;
+    }
+    return;
   }
+  if(putLatestPending_.load() && dispatcher_->schedule(this)) {
+    errorCode_ = ECMC_PV_PUT_ERROR;
+    putLatestPending_ = false;
+  }
+}
+
+// Put connect failed (no putDone() will arrive): allow new put cmds
+void ecmcPv::failPutConnect() {
+  errorCode_ = ECMC_PV_PUT_ERROR;
+  if(putWaitingCmd_.exchange(ECMC_PV_CMD_NONE) != ECMC_PV_CMD_NONE) {
+    hotState().clearBusy();
+  }
+  putLatestPending_ = false;  // pv_put_latest() (not busy)
+}
+
+// Worker thread: add handle sharing this channel
+void ecmcPv::attachHandle(ecmcPv *handle) {
+  epicsMutexLock(sharersMutex_);
+  handle->nextSharer_ = sharers_;
+  sharers_ = handle;
+  handle->hotState().update(channelState_.load());  // From now with all transitions
+  if(type_ == scalarArray && arrayBuffer_) {
+    handle->allocArrayToWrite();
+  }
+  epicsMutexUnlock(sharersMutex_);
+}
+
+// Staging buffer of pv_put_array() (rt -> worker), allocated once when the
+// pv is known to be an array (not from rt)
+void ecmcPv::allocArrayToWrite() {
+  if(!arrayToWrite_ && maxArraySize_ > 0) {
+    arrayToWrite_ = new double[maxArraySize_];
+  }
+}
+
+// Worker thread: remove handle (or this) from channel and destroy its put
+void ecmcPv::detachHandle(ecmcPv *handle) {
+  epicsMutexLock(sharersMutex_);
+  for(ecmcPv **link = &sharers_; *link; link = &(*link)->nextSharer_) {
+    if(*link == handle) {
+      *link = handle->nextSharer_;
+      break;
+    }
+  }
+  handle->nextSharer_ = NULL;
+  handle->destroyPut();
+  epicsMutexUnlock(sharersMutex_);
 }
 
 PvaClientMonitorPtr ecmcPv::getPvaClientMonitor() {
@@ -165,25 +713,28 @@ void ecmcPv::stop()
 
 void ecmcPv::start(const string &request)
 {
-  if(!channelConnected_ || !monitorConnected_)
+  if(channelState_.load() < ECMC_PV_STATE_CONNECTED || !pvaClientMonitor_)
   {
-    cout << "notconnected\n";
+    log(ECMC_PV_LOG_WARNING, "Monitor start while not connected");
   }
   isStarted_ = true;
   pvaClientMonitor_->start(request);
 }
 
 ecmcPv::~ecmcPv() {
-    destructs_ = 1;
-    doCmdEvent_.signal();
-    epicsThreadMustJoin(cmdExeThread_);
+  // Dispatcher workers must be stopped before pv objects are destructed
+  delete arrayBuffer_;
+  delete[] arrayToWrite_;
+  if(sharersMutex_) {
+    epicsMutexDestroy(sharersMutex_);
+  }
 }
 
-std::string ecmcPv::getChannelName(){
+const std::string& ecmcPv::getChannelName(){
   return channelName_;
 }
 
-std::string ecmcPv::getProviderName() {
+const std::string& ecmcPv::getProviderName() {
   return providerName_;
 }
 
@@ -196,238 +747,1213 @@ int ecmcPv::reset() {
   return 0;
 }
 
-double ecmcPv::getLastReadValue() {
-  
-  if (!connected()) {
-    errorCode_ = ECMC_PV_NOT_CONNECTED;
-    throw std::runtime_error("Error: Not connected.");
+// Called from rt: no exceptions, no allocation, no io
+int ecmcPv::getLastReadValue(double *value) {
+  ecmcPvValue latest;
+  int error = readLatestValue(&latest);
+  if(error) {
+    setRtError(ECMC_PV_RT_OP_GET, error);
+    return error;
+  }
+  *value = valueToDouble(latest);
+  return 0;
+}
+
+// Called from rt: exact for integer pvs
+int ecmcPv::getLastReadInt64(int64_t *value) {
+  ecmcPvValue latest;
+  int error = readLatestValue(&latest);
+  if(error) {
+    setRtError(ECMC_PV_RT_OP_GET, error);
+    return error;
+  }
+  *value = valueToInt64(latest);
+  return 0;
+}
+
+// Called from rt: value with alarm and timeStamp
+int ecmcPv::getLastRead(ecmcPvValue *value) {
+  int error = readLatestValue(value);
+  if(error) {
+    setRtError(ECMC_PV_RT_OP_GET, error);
+  }
+  return error;
+}
+
+// Called from rt: latest published value (errors not reported)
+int ecmcPv::readLatestValue(ecmcPvValue *value) {
+  return hot_->read(index_ - 1, value);
+}
+
+double ecmcPv::valueToDouble(const ecmcPvValue &value) {
+  switch(value.kind) {
+    case ECMC_PV_VALUE_INT64:
+      return (double)value.i;
+    case ECMC_PV_VALUE_UINT64:
+      return (double)value.u;
+    default:
+      return value.d;
+  }
+}
+
+// Age from timeStamp if requested (ALARM_TIMESTAMP=1), else from monitor event.
+// Called from rt: wall clock read directly (epicsTimeGetCurrent() locks the
+// generalTime provider list).
+int64_t ecmcPv::valueAgeNs(const ecmcPvValue &value) {
+  if(value.stampNs) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    int64_t nowNs = (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+    return nowNs - value.stampNs;
+  }
+  return (int64_t)(epicsMonotonicGet() - value.eventNs);
+}
+
+// Floating point values are truncated (and limited to the int64 range)
+int64_t ecmcPv::valueToInt64(const ecmcPvValue &value) {
+  switch(value.kind) {
+    case ECMC_PV_VALUE_INT64:
+      return value.i;
+    case ECMC_PV_VALUE_UINT64:
+      return value.u > (uint64_t)INT64_MAX ? INT64_MAX : (int64_t)value.u;
+    default:
+      if(!(value.d > (double)INT64_MIN)) {  // Also NaN
+        return value.d > 0 ? INT64_MAX : INT64_MIN;
+      }
+      if(value.d >= (double)INT64_MAX) {
+        return INT64_MAX;
+      }
+      return (int64_t)value.d;
+  }
+}
+
+// Called from rt at start of cycle: take the array to use in this cycle
+// (value taken from the hot table, see snapshotPvs()). Handles sharing the
+// channel take the array of the source once per cycle.
+void ecmcPv::snapshotArray(uint64_t cycle) {
+  if(source_->snapshotCycle_ == cycle) {
+    return;
   }
+  source_->snapshotCycle_ = cycle;
+  if (source_->type_ == scalarArray && source_->arrayBuffer_) {
+    source_->arrayBuffer_->update();
+  }
+}
 
-  epicsMutexLock(ecmcGetValMutex_);
-  double retVal=valueLatestRead_;
-  epicsMutexUnlock(ecmcGetValMutex_);
-  return retVal;
+void ecmcPv::setSnapshotMode(bool snapshotMode) {
+  snapshotMode_ = snapshotMode;
 }
 
-void ecmcPv::putCmd(double value) {
+// Called from rt: no exceptions, no allocation, no io
+int ecmcPv::putCmd(double value) {
+  ecmcPvValue toWrite;
+  toWrite.d = value;
+  return putValueCmd(toWrite, ECMC_PV_VALUE_DOUBLE);
+}
+
+// Called from rt: exact for integer pvs
+int ecmcPv::putInt64Cmd(int64_t value) {
+  ecmcPvValue toWrite;
+  toWrite.i = value;
+  return putValueCmd(toWrite, ECMC_PV_VALUE_INT64);
+}
+
+// Called from rt: no exceptions, no allocation, no io
+int ecmcPv::putValueCmd(const ecmcPvValue &value, ecmc_pv_value_kind kind) {
 
   reset(); // reset if try again
   
   if (!connected()) {
     errorCode_ = ECMC_PV_NOT_CONNECTED;
-    throw std::runtime_error("Error: Not connected.");
+    setRtError(ECMC_PV_RT_OP_PUT, errorCode_);
+    return errorCode_;
   }
 
-  if(busyLock_.test_and_set()) {
+  if (readOnly_) {
+    errorCode_ = ECMC_PV_READ_ONLY;
+    setRtError(ECMC_PV_RT_OP_PUT, errorCode_);
+    return errorCode_;
+  }
+
+  if(!hotState().lockBusy()) {
     errorCode_ = ECMC_PV_BUSY;
-    throw std::runtime_error("Error: Object busy. Put operation to "+ channelName_ + ") failed." );
+    ecmcPvStats::inc(stats_.busyCount);
+    setRtError(ECMC_PV_RT_OP_PUT, errorCode_);
+    return errorCode_;
   }  
   
-  cmd_ =  ECMC_PV_CMD_PUT;
   valueToWrite_ = value;
+  valueToWriteKind_ = kind;
+  cmd_ =  ECMC_PV_CMD_PUT;  // Publish cmd after data
   
   //Execute cmd
-  doCmdEvent_.signal();
+  if(dispatcher_->schedule(this)) {
+    hotState().clearBusy();
+    errorCode_ = ECMC_PV_PUT_ERROR;
+    setRtError(ECMC_PV_RT_OP_PUT, errorCode_);
+    return errorCode_;
+  }
 
-  return;
+  return 0;
 }
 
-void ecmcPv::regCmd(PvaClientPtr const & pvaClient,
-                    const std::string  & channelName, 
-                    const std::string  & providerName,
-                    const std::string  & request) { // Async Commads
+// Called from rt: no exceptions, no allocation, no io
+int ecmcPv::putArrayCmd(const double *data, size_t count) {
+
   reset(); // reset if try again
-  
-  if(busyLock_.test_and_set()) {
+
+  if (!connected()) {
+    errorCode_ = ECMC_PV_NOT_CONNECTED;
+    setRtError(ECMC_PV_RT_OP_PUT, errorCode_);
+    return errorCode_;
+  }
+
+  if (readOnly_) {
+    errorCode_ = ECMC_PV_READ_ONLY;
+    setRtError(ECMC_PV_RT_OP_PUT, errorCode_);
+    return errorCode_;
+  }
+
+  if (source_->type_ != scalarArray || !arrayToWrite_) {
+    errorCode_ = ECMC_PV_TYPE_NOT_SUPPORTED;
+    setRtError(ECMC_PV_RT_OP_PUT, errorCode_);
+    return errorCode_;
+  }
+
+  if(!hotState().lockBusy()) {
     errorCode_ = ECMC_PV_BUSY;
-    throw std::runtime_error("Error: Object busy. Reg operation to "+ channelName_ + ") failed." );
-  }  
-  inUse_ = true;
-  pva_ = pvaClient;
-  cmd_ =  ECMC_PV_CMD_REG;
-  channelName_ = channelName;
-  providerName_ = providerName;
-  request_ = request;
-  
+    ecmcPvStats::inc(stats_.busyCount);
+    setRtError(ECMC_PV_RT_OP_PUT, errorCode_);
+    return errorCode_;
+  }
+
+  if(count > maxArraySize_) {
+    count = maxArraySize_;
+    arrayTruncatedCount_.fetch_add(1, std::memory_order_relaxed);
+  }
+  memcpy(arrayToWrite_, data, count * sizeof(double));
+  arrayToWriteCount_ = count;
+  cmd_ = ECMC_PV_CMD_PUT_ARRAY;
+
   //Execute cmd
-  doCmdEvent_.signal();
+  if(dispatcher_->schedule(this)) {
+    hotState().clearBusy();
+    errorCode_ = ECMC_PV_PUT_ERROR;
+    setRtError(ECMC_PV_RT_OP_PUT, errorCode_);
+    return errorCode_;
+  }
 
-  return;
+  return 0;
 }
 
-bool ecmcPv::busy() {
-  if(busyLock_.test_and_set()){
-    return true;
+// Called from rt: no exceptions, no allocation, no io
+// Deposit value, a worker sends the latest deposited value as soon as the
+// previous latest value put is done. Overwritten values are counted.
+int ecmcPv::putLatestCmd(double value) {
+
+  if (!connected()) {
+    errorCode_ = ECMC_PV_NOT_CONNECTED;
+    setRtError(ECMC_PV_RT_OP_PUT, errorCode_);
+    return errorCode_;
   }
-  else
-  {
-    busyLock_.clear();
-    return false;
-  }  
+
+  if (readOnly_) {
+    errorCode_ = ECMC_PV_READ_ONLY;
+    setRtError(ECMC_PV_RT_OP_PUT, errorCode_);
+    return errorCode_;
+  }
+
+  if (source_->type_ == scalarArray) {
+    errorCode_ = ECMC_PV_TYPE_NOT_SUPPORTED;
+    setRtError(ECMC_PV_RT_OP_PUT, errorCode_);
+    return errorCode_;
+  }
+
+  putLatestValue_.store(value, std::memory_order_relaxed);
+  if(putLatestPending_.exchange(true)) {
+    // Previous value not sent yet (already scheduled)
+    ecmcPvStats::inc(stats_.coalescedCount);
+    return 0;
+  }
+
+  // putDone() schedules if a put is in flight
+  if(putLatestInFlight_.load() || putCmdInFlight_.load()) {
+    return 0;
+  }
+
+  //Execute cmd
+  if(dispatcher_->schedule(this)) {
+    putLatestPending_ = false;
+    errorCode_ = ECMC_PV_PUT_ERROR;
+    setRtError(ECMC_PV_RT_OP_PUT, errorCode_);
+    return errorCode_;
+  }
+
+  return 0;
 }
 
-bool ecmcPv::inUse() {
-  return inUse_;
+unsigned int ecmcPv::getPutCoalescedCount() {
+  return (unsigned int)stats_.coalescedCount.load(std::memory_order_relaxed);
 }
 
-bool ecmcPv::connected() {
-  return channelConnected_ && monitorConnected_  && isStarted_ && putConnected_ && typeValidated_;
+double ecmcPv::getStat(int stat) {
+  // Monitor statistics are counted by the object owning the channel
+  if(ecmcPvStats::isChannelStat(stat)) {
+    return source_->stats_.get(stat);
+  }
+  return stats_.get(stat);
 }
 
- void ecmcPv::exeCmdThread() {
-  
-  // Create Mutex to protect valueLatestRead_ (accessed from 3 threads)
-  ecmcGetValMutex_ = epicsMutexCreate();
-  if(!ecmcGetValMutex_) {
-    throw std::runtime_error("Error: Create Mutex failed.");
-  }
-
-  while(true) {
-    busyLock_.clear();
-    doCmdEvent_.wait();
-    reset();
-    if(destructs_) {
-      return; 
-    }
+void ecmcPv::resetStats() {
+  stats_.reset();
+}
 
-    switch(cmd_) {
-      case ECMC_PV_CMD_REG:
-        try{          
-          pvaClientChannel_ = pva_->createChannel(channelName_,providerName_);
-          pvaClientChannel_->setStateChangeRequester(shared_from_this());
-          pvaClientChannel_->issueConnect();          
-        }
-        catch(std::exception &e){
-          errorCode_ = ECMC_PV_REG_ERROR;
-        }
-        break;        
-      case ECMC_PV_CMD_PUT:
-        try{
-          if(connected()) {
-            putDouble(valueToWrite_);            
-          }
-        }
-        catch(std::exception &e){
-          errorCode_ = ECMC_PV_PUT_ERROR;
-        }
-        break;
-      default:
-        break;
-    }    
-  } 
-}
+void ecmcPv::updateStats(uint64_t nowNs) {
+  stats_.updateRate(nowNs);
 
-double ecmcPv::getDouble(PvaClientMonitorDataPtr monData) {
-  double retVal = 0;
-  PVScalarPtr pvScalar = NULL;
-  switch(type_) {
-    case scalar:
-      // Scalar types are normal AI/AO VAL fields
-      retVal = monData->getDouble();
-      break;
+  // Server dropped updates since our queue was full
+  uint64_t overruns = stats_.overrunCount.load(std::memory_order_relaxed);
+  if(overruns < overrunReported_) {  // Stats reset
+    overrunReported_ = 0;
+  }
+  if(overruns != overrunReported_) {
+    log(ECMC_PV_LOG_WARNING, "Monitor overrun %llu times (max queue depth %llu), "
+        "consider options QUEUE_SIZE or DRAIN_LAST",
+        (unsigned long long)(overruns - overrunReported_),
+        (unsigned long long)stats_.queueDepthMax.load(std::memory_order_relaxed));
+    overrunReported_ = overruns;
+  }
+}
 
-    case structure:
-      // Support enum records (return the index of the field)
-      pvScalar = monData->getPVStructure()->getSubField<PVScalar>("value.index");      
-      if(pvScalar) {
-        retVal = pvScalar->getAs<double>();        
+// Print statistics (iocsh ecmcPvaReport)
+void ecmcPv::report(int level) {
+  ecmcPvNameBuffer name = nameBuffer_.read();
+  const ecmcPvStats &mon = source_->stats_;  // Monitor of (shared) channel
+  printf("%4d %-40s %-12s %10llu %8.1f %9.1f %9.1f %10llu %8.1f %9.1f %6llu %6llu %4llu %6llu %6llu %4llu\n",
+         index_, name.str, stateToString(getState()),
+         (unsigned long long)stats_.putCount.load(),
+         stats_.putLatency.getAvgUs(), stats_.putLatency.getMaxUs(),
+         mon.eventRate.load(),
+         (unsigned long long)mon.eventCount.load(),
+         stats_.visibleLatency.getAvgUs(), stats_.visibleLatency.getMaxUs(),
+         (unsigned long long)stats_.coalescedCount.load(),
+         (unsigned long long)mon.overrunCount.load(),
+         (unsigned long long)mon.queueDepthMax.load(),
+         (unsigned long long)mon.skippedCount.load(),
+         (unsigned long long)stats_.busyCount.load(),
+         (unsigned long long)mon.reconnectCount.load());
+  if(level < 1) {
+    return;
+  }
+  if(source_ != this) {
+    printf("     shares channel of handle %d\n", source_->index_);
+  } else if(!inUse() && channelRefs_.load() > 0) {
+    printf("     unregistered, channel used by %d handle(s)\n", channelRefs_.load());
+  }
+  const ecmcPvLatencyHist *hists[2] = {&stats_.putLatency, &stats_.visibleLatency};
+  const char *histNames[2] = {"put latency", "visible latency"};
+  for(int h = 0; h < 2; ++h) {
+    printf("     %s histogram [us]:", histNames[h]);
+    for(int i = 0; i < ECMC_PV_STAT_HIST_BINS; ++i) {
+      unsigned int count = hists[h]->getBin(i);
+      if(count == 0) {
+        continue;
+      }
+      if(i < ECMC_PV_STAT_HIST_BINS - 1) {
+        printf(" <%u:%u", 1u << i, count);
       } else {
-        errorCode_ = ECMC_PV_GET_ERROR;
-        return 0;
+        printf(" >=%u:%u", 1u << (i - 1), count);
       }
-      break;
+    }
+    printf("\n");
+  }
+  if(source_->type_ == scalarArray) {
+    printf("     array truncated: %u\n", arrayTruncatedCount_.load());
+  }
+  if(source_->monOptions_.deadband > 0 || source_->monOptions_.deadbandRel > 0) {
+    printf("     deadband filtered: %llu\n", (unsigned long long)mon.filteredCount.load());
+  }
+  printf("     reconnects with cached type: %llu, failed channel retries: %llu\n",
+         (unsigned long long)mon.fastReconnectCount.load(),
+         (unsigned long long)mon.retryCount.load());
+}
 
-    case scalarArray:
-      // not supported yet
-      errorCode_ = ECMC_PV_GET_ERROR;
-      return 0;      
-      break;
+// Called from rt: converts from native element type directly to data
+int ecmcPv::getLastReadArray(double *data, size_t size, size_t *count) {
+
+  *count = 0;
+  if (!hot_->readable(index_ - 1)) {
+    errorCode_ = ECMC_PV_NOT_CONNECTED;
+    setRtError(ECMC_PV_RT_OP_GET, errorCode_);
+    return errorCode_;
+  }
+
+  ecmcPvArrayBuffer *arrayBuffer = source_->arrayBuffer_;
+  if (source_->type_ != scalarArray || !arrayBuffer) {
+    errorCode_ = ECMC_PV_TYPE_NOT_SUPPORTED;
+    setRtError(ECMC_PV_RT_OP_GET, errorCode_);
+    return errorCode_;
+  }
+
+  // Snapshot mode: same data during whole cycle (see snapshot()). All handles
+  // of a shared channel are read by the rt thread (one reader).
+  size_t available = 0;
+  const void *src = snapshotMode_ ? arrayBuffer->peek(&available)
+                                  : arrayBuffer->read(&available);
+  size_t n = available < size ? available : size;
+  castUnsafeV(n, pvDouble, data, source_->arrayElementType_, src);
+  *count = n;
+  return 0;
+}
+
+int ecmcPv::regCmd(PvaClientPtr const & pvaClient,
+                   pvac::ClientProvider const & pvacProvider,
+                   const std::string  & channelName, 
+                   const std::string  & providerName,
+                   const std::string  & request,
+                   const ecmcPvMonitorOptions &options,
+                   bool readOnly,
+                   ecmc_pv_backend backend) { // Async Commads
+  reset(); // reset if try again
+  
+  if(!hotState().lockBusy()) {
+    errorCode_ = ECMC_PV_BUSY;
+    ecmcPvStats::inc(stats_.busyCount);
+    setRtError(ECMC_PV_RT_OP_REG, errorCode_);
+    return errorCode_;
+  }  
+  released_ = false;
+  hotState().rtLastEventNs = 0;
+  hotState().source = index_ - 1;
+  hotState().set(ECMC_PV_STATE_REGISTERING);
+  source_ = this;
+  channelRefs_ = 1;
+  destroyChannel_ = false;
+  stats_.reset();
+  pva_ = pvaClient;
+  pvacProvider_ = pvacProvider;
+  channelName_ = channelName;
+  providerName_ = providerName;
+  request_ = request;
+  monOptions_ = options;
+  readOnly_ = readOnly;
+  backend_ = backend;
+  cmd_ =  ECMC_PV_CMD_REG;  // Publish cmd after data
+
+  ecmcPvNameBuffer name;
+  snprintf(name.str, sizeof(name.str), "%s", channelName.c_str());
+  nameBuffer_.write(name);
+  
+  //Execute cmd
+  if(dispatcher_->schedule(this)) {
+    hotState().set(ECMC_PV_STATE_UNREGISTERED);
+    channelRefs_ = 0;
+    hotState().clearBusy();
+    errorCode_ = ECMC_PV_REG_ERROR;
+    setRtError(ECMC_PV_RT_OP_REG, errorCode_);
+    return errorCode_;
+  }
+
+  return 0;
+}
+
+// Called from rt: use channel and monitor of source (already registered pv),
+// only a put is created for this handle (at first put). Request and monitor
+// options of the source apply.
+int ecmcPv::regSharedCmd(ecmcPv *source,
+                         const std::string  & channelName,
+                         const std::string  & providerName,
+                         bool readOnly) { // Async Commads
+  reset(); // reset if try again
+
+  if(!source || source->getChannelRefs() == 0) {
+    errorCode_ = ECMC_PV_NOT_REGISTERED;
+    setRtError(ECMC_PV_RT_OP_REG, errorCode_);
+    return errorCode_;
+  }
+
+  if(!hotState().lockBusy()) {
+    errorCode_ = ECMC_PV_BUSY;
+    ecmcPvStats::inc(stats_.busyCount);
+    setRtError(ECMC_PV_RT_OP_REG, errorCode_);
+    return errorCode_;
+  }
+  released_ = false;
+  source_ = source->source_;
+  hotState().rtLastEventNs = 0;
+  hotState().source = source_->index_ - 1;  // Value of source
+  hotState().set(ECMC_PV_STATE_REGISTERING);  // State of source set by worker
+  channelRefs_ = 0;
+  destroyChannel_ = false;
+  stats_.reset();
+  source_->channelRefs_.fetch_add(1);
+  channelName_ = channelName;
+  providerName_ = providerName;
+  readOnly_ = readOnly;
+  backend_ = source_->backend_;  // Put on channel of source
+  cmd_ =  ECMC_PV_CMD_REG_SHARED;  // Publish cmd after data
+
+  ecmcPvNameBuffer name;
+  snprintf(name.str, sizeof(name.str), "%s", channelName.c_str());
+  nameBuffer_.write(name);
+
+  //Execute cmd
+  if(dispatcher_->schedule(this)) {
+    source_->channelRefs_.fetch_sub(1);
+    hotState().set(ECMC_PV_STATE_UNREGISTERED);
+    hotState().clearBusy();
+    errorCode_ = ECMC_PV_REG_ERROR;
+    setRtError(ECMC_PV_RT_OP_REG, errorCode_);
+    return errorCode_;
+  }
+
+  return 0;
+}
+
+void ecmcPv::setRtError(ecmc_pv_rt_op op, int errorCode) {
+  errorCode_ = errorCode;
+  rtErrors_[op].errorCode.store(errorCode, std::memory_order_relaxed);
+  rtErrors_[op].count.fetch_add(1, std::memory_order_release);
+}
+
+// Log errors from rt operations since last call (log drain thread)
+void ecmcPv::reportRtErrors() {
+  for(int i = 0; i < ECMC_PV_RT_OP_COUNT; ++i) {
+    ecmcPvRtErrorSlot &slot = rtErrors_[i];
+    unsigned int count = slot.count.load(std::memory_order_acquire);
+    if(count == slot.countReported) {
+      continue;
+    }
+    int errorCode = slot.errorCode.load(std::memory_order_relaxed);
+    log(ECMC_PV_LOG_ERROR, "%s() (handle %d): %s (0x%x, %u times)",
+        rtOpToString((ecmc_pv_rt_op)i), index_, errorToString(errorCode),
+        errorCode, count - slot.countReported);
+    slot.countReported = count;
+  }
+}
+
+// Prefix message with channel name and rate limit per handle
+void ecmcPv::log(int severity, const char *format, ...) {
+  ecmcPvNameBuffer name = nameBuffer_.read();
+  va_list args;
+  va_start(args, format);
+  ecmcPvLogMsgV(severity, index_, name.str, format, args);
+  va_end(args);
+}
 
+const char* ecmcPv::rtOpToString(ecmc_pv_rt_op op) {
+  switch(op) {
+    case ECMC_PV_RT_OP_PUT:
+      return ECMC_PV_PLC_CMD_PV_PUT_ASYN;
+    case ECMC_PV_RT_OP_GET:
+      return ECMC_PV_PLC_CMD_PV_GET_VALUE;
+    case ECMC_PV_RT_OP_REG:
+      return ECMC_PV_PLC_CMD_PV_REG_ASYN;
+    case ECMC_PV_RT_OP_UNREG:
+      return ECMC_PV_PLC_CMD_PV_UNREG_ASYN;
+    default:
+      return "unknown";
+  }
+}
+
+const char* ecmcPv::stateToString(uint32_t state) {
+  switch(state) {
+    case ECMC_PV_STATE_UNREGISTERED:
+      return "unregistered";
+    case ECMC_PV_STATE_REGISTERING:
+      return "registering";
+    case ECMC_PV_STATE_CONNECTING:
+      return "connecting";
+    case ECMC_PV_STATE_CONNECTED:
+      return "connected";
+    case ECMC_PV_STATE_TYPED:
+      return "typed";
+    case ECMC_PV_STATE_DISCONNECTED:
+      return "disconnected";
+    case ECMC_PV_STATE_ERROR:
+      return "error";
+    default:
+      return "unknown";
+  }
+}
+
+const char* ecmcPv::errorToString(int errorCode) {
+  switch(errorCode) {
+    case ECMC_PV_REG_ERROR:
+      return "Register failed";
+    case ECMC_PV_GET_ERROR:
+      return "Get failed";
+    case ECMC_PV_PUT_ERROR:
+      return "Put failed";
+    case ECMC_PV_MON_ERROR:
+      return "Monitor failed";
+    case ECMC_PV_HANDLE_OUT_OF_RANGE:
+      return "Handle out of range";
+    case ECMC_PV_IOC_NOT_STARTED:
+      return "IOC not started";
+    case ECMC_PV_BUSY:
+      return "Object busy";
+    case ECMC_PV_TYPE_NOT_SUPPORTED:
+      return "Type not supported";
+    case ECMC_PV_NOT_CONNECTED:
+      return "Not connected";
+    case ECMC_PV_INIT_ERROR:
+      return "Init failed";
+    case ECMC_PV_NOT_REGISTERED:
+      return "Not registered";
+    case ECMC_PV_READ_ONLY:
+      return "Read only";
+    default:
+      return "Unknown error";
+  }
+}
+
+bool ecmcPv::busy() {
+  return hot_->busy(index_ - 1);
+}
+
+// Called from rt: channel, monitor and put destroyed by worker (see
+// destroyChannel()). Rt calls on the handle fail from now.
+int ecmcPv::unregCmd() {
+  reset();
+
+  if(!inUse()) {
+    errorCode_ = ECMC_PV_NOT_REGISTERED;
+    setRtError(ECMC_PV_RT_OP_UNREG, errorCode_);
+    return errorCode_;
+  }
+
+  if(!hotState().lockBusy()) {
+    errorCode_ = ECMC_PV_BUSY;
+    ecmcPvStats::inc(stats_.busyCount);
+    setRtError(ECMC_PV_RT_OP_UNREG, errorCode_);
+    return errorCode_;
+  }
+
+  uint32_t state = hotState().get();
+  hotState().set(ECMC_PV_STATE_UNREGISTERED);
+  // Last handle using the channel: worker destroys channel and monitor
+  destroyChannel_ = source_->channelRefs_.fetch_sub(1) == 1;
+  cmd_ = ECMC_PV_CMD_UNREG;
+
+  //Execute cmd
+  if(dispatcher_->schedule(this)) {
+    source_->channelRefs_.fetch_add(1);
+    hotState().set(state);
+    hotState().clearBusy();
+    errorCode_ = ECMC_PV_REG_ERROR;
+    setRtError(ECMC_PV_RT_OP_UNREG, errorCode_);
+    return errorCode_;
+  }
+  return 0;
+}
+
+bool ecmcPv::released() {
+  return released_.load(std::memory_order_acquire);
+}
+
+ecmcPv* ecmcPv::getSource() {
+  return source_;
+}
+
+int ecmcPv::getChannelRefs() {
+  return source_->channelRefs_.load();
+}
+
+bool ecmcPv::inUse() {
+  return hotState().get() != ECMC_PV_STATE_UNREGISTERED;
+}
+
+// Put connected on first put (not part of connected)
+bool ecmcPv::connected() {
+  return hot_->connected(index_ - 1);
+}
+
+uint32_t ecmcPv::getState() {
+  return hot_->getState(index_ - 1);
+}
+
+// Channel state transition of source, written to the state word of all
+// handles using the channel (sharersMutex_ locked: transitions come from
+// pva, monitor and worker threads)
+void ecmcPv::updateChannelState(uint32_t state) {
+  channelState_ = state;
+  hotState().update(state);
+  for(ecmcPv *sharer = sharers_; sharer; sharer = sharer->nextSharer_) {
+    sharer->hotState().update(state);
+  }
+}
+
+ecmcPvHotState& ecmcPv::hotState() {
+  return hot_->state(index_ - 1);
+}
+
+// Executed by one of the dispatcher worker threads
+void ecmcPv::exeCmd() {
+  ecmc_pva_cmd cmd = cmd_.exchange(ECMC_PV_CMD_NONE);
+
+  // First put of this handle: connect put first (not for read only handles)
+  bool putCmd = cmd == ECMC_PV_CMD_PUT || cmd == ECMC_PV_CMD_PUT_ARRAY ||
+                (cmd == ECMC_PV_CMD_NONE && putLatestPending_.load());
+  if(putCmd && !putConnected_) {
+    connectPut(cmd);
+    return;
+  }
+
+  // Only pv_put_latest() value to send
+  if(cmd == ECMC_PV_CMD_NONE) {
+    putLatest();
+    return;
+  }
+
+  reset();
+
+  switch(cmd) {
+    case ECMC_PV_CMD_REG:
+      createChannel();
+      break;
+    case ECMC_PV_CMD_RECONNECT:
+      log(ECMC_PV_LOG_INFO, "Recreate failed channel");
+      releaseChannel();
+      createChannel();
+      break;
+    case ECMC_PV_CMD_REG_SHARED:
+      source_->attachHandle(this);
+      break;
+    case ECMC_PV_CMD_PUT:
+    case ECMC_PV_CMD_PUT_ARRAY:
+      // Stay busy until putDone() (one put in flight per handle, the
+      // latest value is chained by putCompleted())
+      if(!connected()) {
+        break;
+      }
+      // Latest value in flight: executed by putCompleted() (unless just done)
+      if(putLatestInFlight_.load()) {
+        putWaitingCmd_ = cmd;
+        if(putLatestInFlight_.load() ||
+           putWaitingCmd_.exchange(ECMC_PV_CMD_NONE) == ECMC_PV_CMD_NONE) {
+          return;
+        }
+      }
+      putCmdInFlight_ = true;
+      try{
+        if((cmd == ECMC_PV_CMD_PUT ?
+            putValue(valueToWrite_, valueToWriteKind_) : putArray()) == 0) {
+          return;
+        }
+      }
+      catch(std::exception &e){
+        errorCode_ = ECMC_PV_PUT_ERROR;
+      }
+      putCmdInFlight_ = false;
+      break;
+    case ECMC_PV_CMD_UNREG:
+      try{
+        source_->detachHandle(this);
+        log(ECMC_PV_LOG_INFO, "Unregistered");
+        if(destroyChannel_) {
+          source_->destroyChannel();
+        }
+      }
+      catch(std::exception &e){
+        errorCode_ = ECMC_PV_REG_ERROR;
+        log(ECMC_PV_LOG_ERROR, "Unregister: %s", e.what());
+      }
+      // Allow new cmds before the slot is handed out again. The slot of the
+      // source is kept until the last handle using its channel is gone.
+      hotState().clearBusy();
+      if(source_ != this) {
+        released_.store(true, std::memory_order_release);
+      }
+      if(destroyChannel_) {
+        source_->released_.store(true, std::memory_order_release);
+      }
+      return;
     default:
-      errorCode_ = ECMC_PV_GET_ERROR;
-      return 0;
       break;
+  }
+
+  // Cmd done.. allow new
+  hotState().clearBusy();
+  putLatest();
+}
 
+// Worker thread (pvac backend): channel and monitor (started when connected)
+void ecmcPv::connectPvac() {
+  PVStructurePtr request = createPvRequest(request_);
+  pvac::ClientChannel channel = pvacProvider_.connect(channelName_);
+  epicsMutexLock(sharersMutex_);
+  pvacChannel_  = channel;
+  epicsMutexUnlock(sharersMutex_);
+  channel.addConnectListener(this);
+  pvacMonitor_ = channel.monitor(this, request);
+  isStarted_ = true;
+}
+
+// Worker thread: channel and monitor of source (REG and RECONNECT)
+void ecmcPv::createChannel() {
+  // Before the channel exists (connect callback can come at once)
+  epicsMutexLock(sharersMutex_);
+  updateChannelState(ECMC_PV_STATE_CONNECTING);
+  epicsMutexUnlock(sharersMutex_);
+  try{
+    if(backend_ == ECMC_PV_BACKEND_PVAC) {
+      connectPvac();
+    } else {
+      PvaClientChannelPtr channel = pva_->createChannel(channelName_,providerName_);
+      epicsMutexLock(sharersMutex_);
+      pvaClientChannel_ = channel;
+      epicsMutexUnlock(sharersMutex_);
+      channel->setStateChangeRequester(shared_from_this());
+      channel->issueConnect();
+    }
+  }
+  catch(std::exception &e){
+    epicsMutexLock(sharersMutex_);
+    channelFailed();
+    epicsMutexUnlock(sharersMutex_);
+    errorCode_ = ECMC_PV_REG_ERROR;
+    log(ECMC_PV_LOG_ERROR, "Register failed: %s", e.what());
   }
-  
-  errorCode_ = ECMC_PV_GET_ERROR;
-  return retVal;
 }
 
-void ecmcPv::putDouble(double value) {
+// Channel or monitor failed (sharersMutex_ locked). Lost connections are
+// reconnected by pvAccess, a failed channel is recreated by a worker after
+// the backoff delay (see checkRetry()).
+void ecmcPv::channelFailed() {
+  updateChannelState(ECMC_PV_STATE_ERROR);
+  if(monOptions_.reconnectDelay <= 0) {
+    return;
+  }
+  retryDelayS_ = retryDelayS_ > 0 ? retryDelayS_ * 2 : monOptions_.reconnectDelay;
+  if(retryDelayS_ > monOptions_.reconnectDelayMax) {
+    retryDelayS_ = monOptions_.reconnectDelayMax;
+  }
+  retryAtNs_ = epicsMonotonicGet() + (uint64_t)(retryDelayS_ * 1e9);
+}
 
-  PVScalarPtr pvScalar = NULL;
-  switch(type_) {
+// Log drain thread: queue recreate of failed channel when the delay passed.
+// Only while the source handle is registered (its busy bit keeps the
+// unregistration and the retry apart).
+void ecmcPv::checkRetry(uint64_t nowNs) {
+  uint64_t retryAtNs = retryAtNs_.load();
+  if(retryAtNs == 0 || nowNs < retryAtNs) {
+    return;
+  }
+  // Cmd of this handle executing: try again next period
+  if(!hotState().lockBusy()) {
+    return;
+  }
+  if(!inUse()) {
+    hotState().clearBusy();
+    return;
+  }
+  retryAtNs_ = 0;
+  ecmcPvStats::inc(stats_.retryCount);
+  cmd_ = ECMC_PV_CMD_RECONNECT;
+  if(dispatcher_->schedule(this)) {
+    retryAtNs_ = retryAtNs;
+    hotState().clearBusy();
+  }
+}
+
+// Worker thread: release monitor and channel (state and handles kept)
+void ecmcPv::releaseChannel() {
+  if(pvaClientMonitor_ && isStarted_) {
+    pvaClientMonitor_->stop();
+  }
+  isStarted_ = false;
+  pvaClientMonitor_.reset();
+  // No more pvac callbacks after cancel() and removeConnectListener()
+  pvacMonitor_.cancel();
+  pvacMonitor_ = pvac::Monitor();
+  if(backend_ == ECMC_PV_BACKEND_PVAC) {
+    pvacChannel_.removeConnectListener(this);
+  }
+  epicsMutexLock(sharersMutex_);
+  pvaClientChannel_.reset();  // Channel destroyed with last reference
+  pvacChannel_  = pvac::ClientChannel();
+  epicsMutexUnlock(sharersMutex_);
+}
+
+// Worker thread: release channel and monitor and reset state so the
+// object can be registered again (last handle using the channel gone).
+void ecmcPv::destroyChannel() {
+  releaseChannel();
+  epicsMutexLock(sharersMutex_);
+  channelState_ = ECMC_PV_STATE_UNREGISTERED;  // All handles unregistered
+  retryAtNs_    = 0;
+  retryDelayS_  = 0;
+  epicsMutexUnlock(sharersMutex_);
+  pva_.reset();
+  pvacProvider_ = pvac::ClientProvider();
+  drainRoot_.reset();
+
+  everConnected_    = false;
+  memset(&monFields_, 0, sizeof(monFields_));
+  clearElementFields();
+  getScalarFunc_    = NULL;
+  typedStructure_.reset();  // Next registration may be another pv
+  type_             = scalar;
+  arrayElementType_ = pvDouble;
+  monUpdateCount_   = 0;
+  monLastValue_     = ecmcPvValue();
+  hot_->value(index_ - 1).value.write(ecmcPvValue());
+  log(ECMC_PV_LOG_INFO, "Channel destroyed");
+}
+
+// Worker thread (sharersMutex_ of source locked, see detachHandle())
+void ecmcPv::destroyPut() {
+  pvaClientPut_.reset();
+  pvacPut_.cancel();
+  pvacPut_ = pvac::Operation();
+  pvacPutRoot_.reset();
+  pvacPutRequest_.reset();
+  putConnected_     = false;
+  putConnectPending_ = false;
+  putWaitingCmd_     = ECMC_PV_CMD_NONE;
+  putStructure_     = NULL;
+  putValueField_.reset();
+  putArrayField_.reset();
+  putLatestPending_  = false;
+  putLatestInFlight_ = false;
+  putCmdInFlight_    = false;
+  putIssueNs_        = 0;
+}
+
+// Worker thread: send latest deposited value unless a put is in flight
+void ecmcPv::putLatest() {
+  if(!putLatestPending_.load()) {
+    return;
+  }
+  // putDone() reschedules
+  if(putCmdInFlight_.load() || putLatestInFlight_.exchange(true)) {
+    return;
+  }
+  // Clear before load so a newer value is never lost (only resent)
+  putLatestPending_ = false;
+  ecmcPvValue value;
+  value.d = putLatestValue_.load(std::memory_order_relaxed);
+  try{
+    if(connected() && putValue(value, ECMC_PV_VALUE_DOUBLE) == 0) {
+      return;
+    }
+  }
+  catch(std::exception &e){
+    errorCode_ = ECMC_PV_PUT_ERROR;
+  }
+  // Nothing issued, no putDone() will arrive
+  putLatestInFlight_ = false;
+}
+
+// Monitor thread: resolve fields by name once per introspection structure
+void ecmcPv::resolveMonitorFields(const PVStructure *pvStructure) {
+  memset(&monFields_, 0, sizeof(monFields_));
+  monFields_.structure = pvStructure->getStructure().get();
+
+  PVFieldPtr field = pvStructure->getSubField("value");
+  if(field && field->getField()->getType() == structure) {
+    // Enum records: index of value
+    field = pvStructure->getSubField("value.index");
+  }
+  if(field) {
+    monFields_.value = field->getFieldOffset();
+  }
+  // Only present if requested (ALARM_TIMESTAMP=1)
+  field = pvStructure->getSubField<PVInt>("alarm.severity");
+  if(field) {
+    monFields_.severity = field->getFieldOffset();
+  }
+  field = pvStructure->getSubField<PVLong>("timeStamp.secondsPastEpoch");
+  if(field) {
+    monFields_.seconds = field->getFieldOffset();
+  }
+  field = pvStructure->getSubField<PVInt>("timeStamp.nanoseconds");
+  if(field) {
+    monFields_.nanoseconds = field->getFieldOffset();
+  }
+}
+
+// Monitor thread: fields resolved in elementFields()
+void ecmcPv::getAlarmTimeStamp(const ecmcPvElementFields &fields, ecmcPvValue *value) {
+  if(fields.severity) {
+    value->severity = fields.severity->get();
+  }
+  if(fields.seconds && fields.nanoseconds) {
+    value->stampNs = fields.seconds->get() * 1000000000LL + fields.nanoseconds->get();
+  }
+}
+
+// Monitor thread: read value in native type (see validateType())
+int ecmcPv::getValue(const ecmcPvElementFields &fields, ecmcPvValue *value) {
+  // Arrays: use getLastReadArray(). Type checked in validateType()
+  if(type_ == scalarArray || !fields.value || !getScalarFunc_) {
+    errorCode_ = ECMC_PV_GET_ERROR;
+    return errorCode_;
+  }
+  getScalarFunc_(fields.value, value);
+  return 0;
+}
+
+// Monitor thread: true if change since last published value is within the
+// deadband(s) and the severity is unchanged (value then not published)
+bool ecmcPv::inDeadband(const ecmcPvValue &value) {
+  double deadband    = monOptions_.deadband;
+  double deadbandRel = monOptions_.deadbandRel;
+  if((deadband <= 0 && deadbandRel <= 0) || monUpdateCount_ == 0) {
+    return false;
+  }
+  if(value.severity != monLastValue_.severity) {
+    return false;
+  }
+  double last = valueToDouble(monLastValue_);
+  double diff = fabs(valueToDouble(value) - last);
+  // NaN never in deadband
+  if(deadband > 0 && !(diff <= deadband)) {
+    return false;
+  }
+  if(deadbandRel > 0 && !(diff <= deadbandRel * fabs(last))) {
+    return false;
+  }
+  return true;
+}
+
+// Monitor thread: reference to array data in native type (no copy)
+int ecmcPv::viewArray(const ecmcPvElementFields &fields, shared_vector<const void> *data) {
+  const PVScalarArray *pvArray = fields.array;
+  if(!pvArray) {
+    errorCode_ = ECMC_PV_GET_ERROR;
+    return errorCode_;
+  }
+
+  switch(arrayElementType_) {
+    case pvBoolean: *data = viewArrayAs<boolean>(pvArray); break;
+    case pvByte:    *data = viewArrayAs<int8>(pvArray);    break;
+    case pvShort:   *data = viewArrayAs<int16>(pvArray);   break;
+    case pvInt:     *data = viewArrayAs<int32>(pvArray);   break;
+    case pvLong:    *data = viewArrayAs<int64>(pvArray);   break;
+    case pvUByte:   *data = viewArrayAs<uint8>(pvArray);   break;
+    case pvUShort:  *data = viewArrayAs<uint16>(pvArray);  break;
+    case pvUInt:    *data = viewArrayAs<uint32>(pvArray);  break;
+    case pvULong:   *data = viewArrayAs<uint64>(pvArray);  break;
+    case pvFloat:   *data = viewArrayAs<float>(pvArray);   break;
+    case pvDouble:  *data = viewArrayAs<double>(pvArray);  break;
+    default:
+      errorCode_ = ECMC_PV_TYPE_NOT_SUPPORTED;
+      return errorCode_;
+  }
+  return 0;
+}
+
+// Monitor thread: copy array to back buffer and publish to rt
+int ecmcPv::publishArray(const shared_vector<const void> &data) {
+  if(!arrayBuffer_) {
+    errorCode_ = ECMC_PV_GET_ERROR;
+    return errorCode_;
+  }
+
+  // Size of void vectors in bytes
+  size_t elementSize = ScalarTypeFunc::elementSize(arrayElementType_);
+  size_t length      = data.size() / elementSize;
+  size_t capacity    = arrayBuffer_->getCapacity();
+  size_t count       = length < capacity ? length : capacity;
+  memcpy(arrayBuffer_->getWriteBuffer(), data.data(), count * elementSize);
+  if(count < length) {
+    arrayTruncatedCount_.fetch_add(1, std::memory_order_relaxed);
+    log(ECMC_PV_LOG_WARNING, "Array truncated from %lu to %lu elements (MAX_ARRAY_SIZE)",
+        (unsigned long)length, (unsigned long)count);
+  }
+  arrayBuffer_->publish(count);
+  return 0;
+}
+
+// Worker thread: stage array put (written to the put field now (pvaClient)
+// or in putBuild() (pvac))
+int ecmcPv::putArray() {
+  putStagedArray_ = true;
+  if(backend_ == ECMC_PV_BACKEND_PVACLIENT) {
+    int error = writeArray();
+    if(error) {
+      return error;
+    }
+  }
+  issuePut();
+  return 0;
+}
+
+// Convert staged rt data directly into the put field
+int ecmcPv::writeArray() {
+  const PVScalarArrayPtr &pvArray = putArrayField_;
+  if(!pvArray) {
+    errorCode_ = ECMC_PV_PUT_ERROR;
+    return errorCode_;
+  }
+
+  const double *data = arrayToWrite_;
+  size_t count = arrayToWriteCount_;
+  switch(pvArray->getScalarArray()->getElementType()) {
+    case pvBoolean: putArrayAs<boolean>(pvArray, data, count); break;
+    case pvByte:    putArrayAs<int8>(pvArray, data, count);    break;
+    case pvShort:   putArrayAs<int16>(pvArray, data, count);   break;
+    case pvInt:     putArrayAs<int32>(pvArray, data, count);   break;
+    case pvLong:    putArrayAs<int64>(pvArray, data, count);   break;
+    case pvUByte:   putArrayAs<uint8>(pvArray, data, count);   break;
+    case pvUShort:  putArrayAs<uint16>(pvArray, data, count);  break;
+    case pvUInt:    putArrayAs<uint32>(pvArray, data, count);  break;
+    case pvULong:   putArrayAs<uint64>(pvArray, data, count);  break;
+    case pvFloat:   putArrayAs<float>(pvArray, data, count);   break;
+    case pvDouble:  putArrayAs<double>(pvArray, data, count);  break;
+    default:
+      errorCode_ = ECMC_PV_TYPE_NOT_SUPPORTED;
+      return errorCode_;
+  }
+  return 0;
+}
+
+// Worker thread: issue put and start latency measurement (see putDone())
+void ecmcPv::issuePut() {
+  ecmcPvStats::inc(stats_.putCount);
+  putIssueNs_.store(epicsMonotonicGet(), std::memory_order_relaxed);
+  if(backend_ == ECMC_PV_BACKEND_PVACLIENT) {
+    pvaClientPut_->issuePut();
+    return;
+  }
+  // pvac: one operation per put on the (shared) channel
+  epicsMutexLock(source_->sharersMutex_);
+  pvac::ClientChannel channel = source_->pvacChannel_;
+  epicsMutexUnlock(source_->sharersMutex_);
+  pvacPut_ = channel.put(this, pvacPutRequest_);
+}
+
+// Pva thread: resolve fields once per put connect (pvStructure reused by all puts)
+void ecmcPv::resolvePutFields(const PVStructurePtr &pvStructure) {
+  if(pvStructure.get() == putStructure_) {
+    return;
+  }
+  putStructure_ = pvStructure.get();
+  putValueField_.reset();
+  putArrayField_.reset();
+
+  PVFieldPtr field = pvStructure->getSubField("value");
+  if(!field) {
+    return;
+  }
+  switch(field->getField()->getType()) {
     case scalar:
-      pvaClientPut_->getData()->putDouble(value);
-      //pvaClientPut_->put();
-      pvaClientPut_->issuePut();
+      putValueField_ = pvStructure->getSubField<PVScalar>("value");
       break;
-
     case structure:
       // Support enum BI/BO records
-      pvScalar = pvaClientPut_->getData()->getPVStructure()->getSubField<PVScalar>("value.index");
-      if(pvScalar) {
-        pvScalar->putFrom<double>(value);
-        //pvaClientPut_->put();
-        pvaClientPut_->issuePut();
-      } else {
-        errorCode_ = ECMC_PV_GET_ERROR;
-        return;
-      }
+      putValueField_ = pvStructure->getSubField<PVScalar>("value.index");
       break;
-
     case scalarArray:
-      errorCode_ = ECMC_PV_GET_ERROR; 
-      return;
+      putArrayField_ = pvStructure->getSubField<PVScalarArray>("value");
       break;
-
     default:
-      errorCode_ = ECMC_PV_GET_ERROR;
-      return;
       break;
   }
+}
 
-  return;
+// Worker thread: stage value put (written to the put field now (pvaClient)
+// or in putBuild() (pvac))
+int ecmcPv::putValue(const ecmcPvValue &value, ecmc_pv_value_kind kind) {
+  if(source_->type_ == scalarArray) {
+    errorCode_ = ECMC_PV_GET_ERROR;
+    return errorCode_;
+  }
+  putStaged_      = value;
+  putStagedKind_  = kind;
+  putStagedArray_ = false;
+  if(backend_ == ECMC_PV_BACKEND_PVACLIENT) {
+    int error = writeValue();
+    if(error) {
+      return error;
+    }
+  }
+  issuePut();
+  return 0;
 }
 
-int ecmcPv::validateType(PvaClientMonitorDataPtr monData) {
+// Integers are written without conversion via double
+int ecmcPv::writeValue() {
+  const PVScalarPtr &pvScalar = putValueField_;
+  if(!pvScalar) {
+    errorCode_ = ECMC_PV_GET_ERROR;
+    return errorCode_;
+  }
 
-  if(!monData->hasValue()) {
+  switch(putStagedKind_) {
+    case ECMC_PV_VALUE_INT64:
+      pvScalar->putFrom<int64>(putStaged_.i);
+      break;
+    case ECMC_PV_VALUE_UINT64:
+      pvScalar->putFrom<uint64>(putStaged_.u);
+      break;
+    default:
+      pvScalar->putFrom<double>(putStaged_.d);
+      break;
+  }
+  return 0;
+}
+
+// Monitor thread: select native storage of value (see getScalarFunc())
+int ecmcPv::validateType(const PVStructure *pvStructure) {
+
+  PVFieldPtr value = pvStructure->getSubField("value");
+  if(!value) {
     return 0;
   }
-  PVScalarPtr pvScalar = NULL;  // Need to redo
+  PVScalarPtr pvScalar;
 
   // Assign type
-  type_ = monData->getValue()->getField()->getType();
+  type_ = value->getField()->getType();
 
   switch(type_) {
     case scalar:
-      if(monData->isValueScalar()) {
-        return 1;
-      }
-      else {
+      pvScalar = std::tr1::static_pointer_cast<PVScalar>(value);
+      getScalarFunc_ = getScalarFunc(pvScalar->getScalar()->getScalarType(), &valueKind_);
+      if(!getScalarFunc_) {
+        log(ECMC_PV_LOG_ERROR, "Scalar type not supported (string)");
         return 0;
-      }      
-      break;
+      }
+      return 1;
     case structure:
       // Support enum BI/BO records enum type (index, choices)
-      if(!(monData->getValue()->getField()->getID()=="enum_t")) {
-        cout << "NOT ENUM_T\n";
+      if(!(value->getField()->getID()=="enum_t")) {
+        log(ECMC_PV_LOG_ERROR, "Structure not enum_t (id %s)",
+            value->getField()->getID().c_str());
         return 0;
       }
 
-      pvScalar = monData->getPVStructure()->getSubField<PVScalar>("value.index");
+      pvScalar = pvStructure->getSubField<PVScalar>("value.index");
       if (pvScalar) {
-        return 1;
+        getScalarFunc_ = getScalarFunc(pvScalar->getScalar()->getScalarType(), &valueKind_);
+        return getScalarFunc_ != NULL;
       } else {
-        cout << "NOT PVSCALAR\n";
+        log(ECMC_PV_LOG_ERROR, "Field value.index not a scalar");
         return 0;
       }       
 
       break;
     case scalarArray:
-      return 0;
+      arrayElementType_ = std::tr1::static_pointer_cast<const ScalarArray>(
+                            value->getField())->getElementType();
+      if(arrayElementType_ == pvString) {
+        log(ECMC_PV_LOG_ERROR, "String arrays not supported");
+        return 0;
+      }
+      // Allocate once, sized for any numeric element type
+      if(!arrayBuffer_ && maxArraySize_ > 0) {
+        arrayBuffer_  = new ecmcPvArrayBuffer(maxArraySize_, sizeof(double));
+      }
+      // Put buffers of all handles using this channel
+      epicsMutexLock(sharersMutex_);
+      allocArrayToWrite();
+      for(ecmcPv *sharer = sharers_; sharer; sharer = sharer->nextSharer_) {
+        sharer->allocArrayToWrite();
+      }
+      epicsMutexUnlock(sharersMutex_);
+      return arrayBuffer_ != NULL;
       break;
 
     default:
@@ -438,9 +1964,21 @@ int ecmcPv::validateType(PvaClientMonitorDataPtr monData) {
   return 0;
 }
 
-// Static Avoid issues with std:to_string()
-std::string ecmcPv::to_string(int value) {
-  std::ostringstream os;
-  os << value;
-  return os.str();
+// Names of BACKEND option values
+const char* ecmcPv::backendToString(ecmc_pv_backend backend) {
+  return backend == ECMC_PV_BACKEND_PVAC ? ECMC_PV_BACKEND_NAME_PVAC
+                                         : ECMC_PV_BACKEND_NAME_PVACLIENT;
+}
+
+// Returns 0 or -1 if unknown name
+int ecmcPv::backendFromString(const char *name, ecmc_pv_backend *backend) {
+  if(!strcmp(name, ECMC_PV_BACKEND_NAME_PVACLIENT)) {
+    *backend = ECMC_PV_BACKEND_PVACLIENT;
+    return 0;
+  }
+  if(!strcmp(name, ECMC_PV_BACKEND_NAME_PVAC)) {
+    *backend = ECMC_PV_BACKEND_PVAC;
+    return 0;
+  }
+  return -1;
 }
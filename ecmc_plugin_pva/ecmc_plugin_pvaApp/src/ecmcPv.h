@@ -11,10 +11,16 @@
 *  Pv access support for ecmc:
 *  * pv_reg_asyn()  : async command to register a pv
 *  * pv_put_asyn()  : async command to write to a pv
+*  * pv_put_latest(): write, latest value wins (coalesced)
 *  * pv_get_value() : return last value (from monitor)
-*  The async commands are executed in a worker thread. This was needed
-*  since even the "issue*()" commands was found to block for to 
-*  long time. 
+*  The async commands are executed by a shared pool of worker threads
+*  (ecmcPvCmdDispatcher). This was needed since even the "issue*()"
+*  commands was found to block for to long time. 
+*  Handles registering the same pv share the channel and monitor of the
+*  first registered object (the source), each handle has its own put.
+*  Two client backends (BACKEND option): pvaClient (default) and the lower
+*  level pvac api (no intermediate PvaClient objects, puts are one shot
+*  operations on the shared channel).
 *
 *  Implementation is based on examples found in:
 *  https://github.com/epics-base/exampleCPP.git 
@@ -25,12 +31,18 @@
 #define ECMC_PV_H_
 
 #include "ecmcPvDefs.h"
+#include "ecmcPvCmdDispatcher.h"
+#include "ecmcPvSeqLock.h"
+#include "ecmcPvLog.h"
+#include "ecmcPvArrayBuffer.h"
+#include "ecmcPvStats.h"
+#include "ecmcPvHotTable.h"
+#include "epicsMutex.h"
 #include <atomic>  
 #include <iostream>
 #include <pv/pvaClient.h>
+#include <pva/client.h>
 
-#include "epicsThread.h"
-#include "epicsMutex.h"
 
 using namespace std;
 using namespace epics::pvData;
@@ -38,17 +50,94 @@ using namespace epics::pvAccess;
 using namespace epics::pvaClient;
 
 enum ecmc_pva_cmd {
-  ECMC_PV_CMD_NONE = 0,
-  ECMC_PV_CMD_REG  = 1,
-  ECMC_PV_CMD_PUT  = 2
+  ECMC_PV_CMD_NONE      = 0,
+  ECMC_PV_CMD_REG       = 1,
+  ECMC_PV_CMD_PUT       = 2,
+  ECMC_PV_CMD_PUT_ARRAY = 3,
+  ECMC_PV_CMD_UNREG     = 4,
+  ECMC_PV_CMD_REG_SHARED= 5,  // Put on channel of other object
+  ECMC_PV_CMD_RECONNECT = 6   // Recreate failed channel (see checkRetry())
+};
+
+// Client api used for channel, monitor and put (BACKEND option)
+enum ecmc_pv_backend {
+  ECMC_PV_BACKEND_PVACLIENT = 0,
+  ECMC_PV_BACKEND_PVAC      = 1
+};
+
+// Realtime operations with own error slot (reported off rt thread)
+enum ecmc_pv_rt_op {
+  ECMC_PV_RT_OP_PUT   = 0,
+  ECMC_PV_RT_OP_GET   = 1,
+  ECMC_PV_RT_OP_REG   = 2,
+  ECMC_PV_RT_OP_UNREG = 3,
+  ECMC_PV_RT_OP_COUNT = 4
+};
+
+// Error slot written by rt thread with plain atomic stores
+struct ecmcPvRtErrorSlot {
+  std::atomic<int>          errorCode;
+  std::atomic<unsigned int> count;
+  unsigned int              countReported;  // Only accessed by reporter
+};
+
+// Reads a monitored scalar into the native storage (no conversion via double)
+typedef void (*ecmcPvGetScalarFunc)(PVScalar *pvScalar, ecmcPvValue *value);
+
+// Field offsets resolved once per introspection structure (0 if not found)
+struct ecmcPvFieldOffsets {
+  const Structure *structure;  // Introspection the offsets are valid for
+  size_t           value;      // value or value.index (enum_t)
+  size_t           severity;   // alarm.severity
+  size_t           seconds;    // timeStamp.secondsPastEpoch
+  size_t           nanoseconds;// timeStamp.nanoseconds
+};
+
+// Monitor elements with fields resolved (pvaClient reuses a fixed set of
+// elements per monitor, pvac and DRAIN_LAST decode from one root)
+#define ECMC_PV_ELEMENT_CACHE_SIZE 8
+
+// Typed fields of one monitor element, resolved from ecmcPvFieldOffsets at
+// the first event of the element (NULL if not present)
+struct ecmcPvElementFields {
+  PVStructureConstPtr element;  // Held: address not reused while cached
+  PVScalar           *value;
+  PVScalarArray      *array;
+  PVInt              *severity;
+  PVLong             *seconds;
+  PVInt              *nanoseconds;
+};
+
+// Monitor options of pv_reg_asyn() (see parseRegOptions() in ecmcPvaWrap.cpp)
+struct ecmcPvMonitorOptions {
+  double deadband;     // Absolute, 0: off
+  double deadbandRel;  // Relative to last published value, 0: off
+  bool   drainLast;    // Only decode/publish last element of each event()
+  double reconnectDelay;     // First retry of failed channel [s], 0: off
+  double reconnectDelayMax;  // Retry delay doubled up to this [s]
+};
+
+// State of one monitor event (all queued elements drained)
+struct ecmcPvEventDrain {
+  uint64_t depth;   // Elements drained
+  bool     staged;  // DRAIN_LAST: element polled, not yet decoded
+};
+
+// Fixed size copy of channel name that can be read from any thread
+struct ecmcPvNameBuffer {
+  char str[ECMC_PV_NAME_MAX_LEN];
 };
 
  class ecmcPv;
  typedef std::tr1::shared_ptr<ecmcPv> ecmcPvPtr;
 
-class ecmcPv :  public PvaClientChannelStateChangeRequester,
+class ecmcPv :  public ecmcPvCmdItem,
+                public PvaClientChannelStateChangeRequester,
                 public PvaClientMonitorRequester,
                 public PvaClientPutRequester,
+                public pvac::ClientChannel::ConnectCallback,
+                public pvac::ClientChannel::MonitorCallback,
+                public pvac::ClientChannel::PutCallback,
                 public std::tr1::enable_shared_from_this<ecmcPv>
 {
  public:
@@ -56,7 +145,10 @@ class ecmcPv :  public PvaClientChannelStateChangeRequester,
   ecmcPv(const std::string &channelName,
          const std::string &providerName,
          const std::string &request, 
-         int index);
+         int index,
+         ecmcPvCmdDispatcher *dispatcher,
+         size_t maxArraySize,
+         ecmcPvHotTable *hotTable);
   ecmcPv();
 
   ~ecmcPv();
@@ -65,25 +157,67 @@ class ecmcPv :  public PvaClientChannelStateChangeRequester,
                           const std::string  & channelName, 
                           const std::string  & providerName,
                           const std::string  & request,
-                          int index);
+                          int index,
+                          ecmcPvCmdDispatcher *dispatcher,
+                          size_t maxArraySize,
+                          ecmcPvHotTable *hotTable);
   void   init(/*PvaClientPtr const &pvaClient*/);
   PvaClientMonitorPtr getPvaClientMonitor();
   int    getError();
   int    reset();
   void   start(const string &request);
   void   stop();  
-  void   putCmd(double value); // Async Commads
-  void   regCmd(PvaClientPtr const & pvaClient,
+  int    putCmd(double value); // Async Commads
+  int    putInt64Cmd(int64_t value); // Async Commads
+  int    regCmd(PvaClientPtr const & pvaClient,
+                pvac::ClientProvider const & pvacProvider,
                 const std::string  & channelName, 
                 const std::string  & providerName,
-                const std::string  & request); // Async Commads
-  double getLastReadValue();
+                const std::string  & request,
+                const ecmcPvMonitorOptions &options,
+                bool readOnly,
+                ecmc_pv_backend backend); // Async Commads
+  int    regSharedCmd(ecmcPv *source,
+                      const std::string  & channelName,
+                      const std::string  & providerName,
+                      bool readOnly); // Async Commads
+  int    unregCmd(); // Async Commads
+  bool   released();  // Unregistration done (slot can be reused)
+  ecmcPv* getSource();       // Object owning channel and monitor
+  int    getChannelRefs();   // Handles using the channel of the source
+  int    getLastReadValue(double *value);
+  int    getLastReadInt64(int64_t *value);
+  int    getLastRead(ecmcPvValue *value);
+  void   snapshotArray(uint64_t cycle);  // Rt: at start of cycle (SNAPSHOT=1)
+  static double  valueToDouble(const ecmcPvValue &value);
+  static int64_t valueToInt64(const ecmcPvValue &value);
+  static int64_t valueAgeNs(const ecmcPvValue &value);
+  void   setSnapshotMode(bool snapshotMode);
+  int    putArrayCmd(const double *data, size_t count); // Async Commads
+  int    putLatestCmd(double value); // Async Commads (never busy)
+  unsigned int getPutCoalescedCount();
+  double getStat(int stat);
+  void   resetStats();
+  void   updateStats(uint64_t nowNs);  // Not from rt thread
+  void   checkRetry(uint64_t nowNs);   // Not from rt thread
+  void   report(int level);            // Not from rt thread
+  int    getLastReadArray(double *data, size_t size, size_t *count);
+  void   setRtError(ecmc_pv_rt_op op, int errorCode);
+  void   reportRtErrors();  // Not from rt thread
+  void   log(int severity, const char *format, ...)
+           __attribute__((format(printf, 3, 4)));
+  static const char* errorToString(int errorCode);
+  static const char* rtOpToString(ecmc_pv_rt_op op);
+  static const char* stateToString(uint32_t state);
+  static const char* backendToString(ecmc_pv_backend backend);
+  static int   backendFromString(const char *name, ecmc_pv_backend *backend);
   bool   busy();
   bool   inUse();
   bool   connected();
-  void   exeCmdThread();
-  std::string getChannelName();
-  std::string getProviderName();
+  uint32_t getState();
+  void   exeCmd();
+  const std::string& getChannelName();
+  const std::string& getProviderName();
   virtual void monitorConnect(epics::pvData::Status const & status,
                               PvaClientMonitorPtr const & monitor,
                               epics::pvData::StructureConstPtr const & structure);
@@ -94,45 +228,151 @@ class ecmcPv :  public PvaClientChannelStateChangeRequester,
                                   bool isConnected);
   virtual void putDone(const epics::pvData::Status & status,
                        PvaClientPutPtr const & clientPut);
+  // pvac backend
+  virtual void connectEvent(const pvac::ConnectEvent &evt);
+  virtual void monitorEvent(const pvac::MonitorEvent &evt);
+  virtual void putBuild(const StructureConstPtr &build,
+                        pvac::ClientChannel::PutCallback::Args &args);
+  virtual void putDone(const pvac::PutEvent &evt);
 
  private:
-  int    validateType(PvaClientMonitorDataPtr monData);
-  double getDouble(PvaClientMonitorDataPtr monData);
-  void   putDouble(double value);
-  static std::string to_string(int value);
+  int    validateType(const PVStructure *pvStructure);
+  int    decodeElement(const PVStructureConstPtr &pvStructure,
+                       ecmcPvValue *latest, shared_vector<const void> *array);
+  void   countElement(ecmcPvEventDrain *drain, bool overrun);
+  void   stageElement(const PVStructurePtr &pvStructure, const BitSet &changed);
+  int    publishElement(const PVStructureConstPtr &pvStructure);
+  void   finishDrain(ecmcPvEventDrain *drain, const PVStructureConstPtr &staged);
+  const ecmcPvElementFields& elementFields(const PVStructureConstPtr &pvStructure);
+  void   clearElementFields();
+  void   connectionChanged(bool isConnected);
+  void   connectPvac();
+  void   createChannel();
+  void   releaseChannel();
+  void   channelFailed();
+  void   putCompleted(bool ok, const std::string &message);
+  int    writeValue();
+  int    writeArray();
+  int    getValue(const ecmcPvElementFields &fields, ecmcPvValue *value);
+  bool   inDeadband(const ecmcPvValue &value);
+  void   resolveMonitorFields(const PVStructure *pvStructure);
+  void   resolvePutFields(const PVStructurePtr &pvStructure);
+  int    putValue(const ecmcPvValue &value, ecmc_pv_value_kind kind);
+  int    putValueCmd(const ecmcPvValue &value, ecmc_pv_value_kind kind);
+  void   putLatest();
+  void   abortPutInFlight();
+  void   destroyChannel();
+  void   destroyPut();
+  void   connectPut(ecmc_pva_cmd cmd);
+  void   failPutConnect();
+  void   replayPutCmds();
+  void   attachHandle(ecmcPv *handle);
+  void   allocArrayToWrite();
+  void   detachHandle(ecmcPv *handle);
+  void   updateChannelState(uint32_t state);
+  ecmcPvHotState& hotState();
+  int    readLatestValue(ecmcPvValue *value);
+  void   issuePut();
+  int    viewArray(const ecmcPvElementFields &fields, shared_vector<const void> *data);
+  int    publishArray(const shared_vector<const void> &data);
+  void   publish(ecmcPvValue &latest, const shared_vector<const void> &array);
+  void   getAlarmTimeStamp(const ecmcPvElementFields &fields, ecmcPvValue *value);
+  int    putArray();
 
   std::string  channelName_;
   std::string  providerName_;
   std::string  request_;
-  bool         channelConnected_;
-  bool         monitorConnected_;
-  bool         putConnected_;
-  bool         isStarted_;
-  bool         typeValidated_;
-  bool         destructs_;
-  bool         inUse_;
+  std::atomic<bool> putConnected_;  // Put usable (not part of connected())
+  bool         isStarted_;      // pvaClient monitor started (not read by rt)
+  std::atomic<uint32_t> channelState_;  // ECMC_PV_STATE_* of channel (source)
+  std::atomic<bool> released_;  // Set by worker when unregistration done
+  ecmcPv      *source_;          // this or object owning the shared channel
+  std::atomic<int> channelRefs_; // Handles using this channel (only changed by rt)
+  bool         destroyChannel_;  // Last reference gone (set by unregCmd())
+  bool         readOnly_;        // No put (READ_ONLY=1)
+  ecmc_pv_backend backend_;      // Of source (set at registration)
   int          index_;
   int          errorCode_;  
-  double       valueLatestRead_;
-  double       valueToWrite_;  
+  ecmcPvHotTable *hot_;         // Rt state (value, flags) of slot index_-1
+  bool         snapshotMode_;   // Arrays only updated by snapshot()
+  uint64_t     snapshotCycle_;  // Last cycle array taken (rt, see snapshotArray())
+  ecmcPvValue  valueToWrite_;  
+  ecmc_pv_value_kind  valueToWriteKind_;
+  ecmc_pv_value_kind  valueKind_;      // Of monitored value
+  ecmcPvGetScalarFunc getScalarFunc_;  // Chosen in validateType()
   Type         type_;  
-  ecmc_pva_cmd cmd_;
-  std::atomic_flag busyLock_;  
+  std::atomic<ecmc_pva_cmd> cmd_;  // Taken by worker in exeCmd()
+  ecmcPvRtErrorSlot rtErrors_[ECMC_PV_RT_OP_COUNT];
+  ecmcPvSeqLock<ecmcPvNameBuffer> nameBuffer_;
+
   
   // General
   PvaClientPtr        pva_;
   PvaClientChannelPtr pvaClientChannel_;    
+
+  // Handles sharing the channel (intrusive list, no allocation). The mutex
+  // also protects pvaClientChannel_, pvacChannel_ and the channel state
+  // transitions (see updateChannelState()).
+  epicsMutexId        sharersMutex_;
+  ecmcPv             *sharers_;
+  ecmcPv             *nextSharer_;
   
-  // Put
+  // Put (created at first put, fields resolved in channelPutConnect())
   PvaClientPutPtr     pvaClientPut_;
+  const PVStructure  *putStructure_;
+  PVScalarPtr         putValueField_;
+  PVScalarArrayPtr    putArrayField_;
+  ecmcPvValue         putStaged_;       // Written to put field by writeValue()
+  ecmc_pv_value_kind  putStagedKind_;
+  bool                putStagedArray_;  // arrayToWrite_ staged (writeArray())
+
+  // pvac backend (channel and monitor only used in source)
+  pvac::ClientProvider pvacProvider_;   // Shared per provider name (see regCmd())
+  pvac::ClientChannel pvacChannel_;
+  pvac::Monitor       pvacMonitor_;
+  pvac::Operation     pvacPut_;         // Last put issued
+  PVStructurePtr      pvacPutRequest_;
+  PVStructurePtr      pvacPutRoot_;     // Reused by all puts (see putBuild())
 
   // Monitor       
   PvaClientMonitorPtr pvaClientMonitor_;
+  PVStructurePtr      drainRoot_;       // DRAIN_LAST: polled elements merged
+  ecmcPvFieldOffsets  monFields_;  // Only accessed by monitor thread
+  ecmcPvElementFields monElements_[ECMC_PV_ELEMENT_CACHE_SIZE];  // Of monFields_
+  size_t              monElementNext_;  // Replaced next at a cache miss
+  StructureConstPtr   typedStructure_;  // Validated type (kept over reconnects)
+  uint64_t            monUpdateCount_;
+  ecmcPvValue         monLastValue_;   // Last published (deadband)
+  ecmcPvMonitorOptions monOptions_;
+  uint64_t            overrunReported_;  // Only accessed by updateStats()
   
   // Thread related
-  epicsEvent          doCmdEvent_;
-  epicsThreadId       cmdExeThread_;
-  epicsMutexId        ecmcGetValMutex_;  
+  ecmcPvCmdDispatcher *dispatcher_;
+
+  // Arrays (buffers allocated when an array pv connects)
+  size_t              maxArraySize_;
+  ScalarType          arrayElementType_;
+  ecmcPvArrayBuffer  *arrayBuffer_;        // monitor -> rt
+  double             *arrayToWrite_;       // rt -> worker
+  size_t              arrayToWriteCount_;
+  std::atomic<unsigned int> arrayTruncatedCount_;
+
+  // Latest value put (rt deposits, worker sends when previous put is done)
+  std::atomic<double>       putLatestValue_;
+  std::atomic<bool>         putLatestPending_;   // Value not yet sent
+  std::atomic<bool>         putLatestInFlight_;  // Waiting for putDone()
+  std::atomic<bool>         putCmdInFlight_;     // Put cmd waiting for putDone()
+  std::atomic<bool>         putConnectPending_;  // Put connect issued
+  std::atomic<ecmc_pva_cmd> putWaitingCmd_;      // Put cmd waiting for put connect or putDone()
+
+  // Statistics
+  ecmcPvStats               stats_;
+  std::atomic<uint64_t>     putIssueNs_;
+  bool                      everConnected_;
+
+  // Retry of failed channel (source only, delays guarded by sharersMutex_)
+  std::atomic<uint64_t>     retryAtNs_;   // 0: no retry pending
+  double                    retryDelayS_; // Delay of last retry, 0: first
 };
 
 #endif  /* ECMC_PV_H_ */
@@ -0,0 +1,97 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcPvArrayBuffer.h
+*
+*  Created on: Oct 17, 2026
+*      Author: anderssandstrom
+*
+*  Preallocated triple buffer for array (waveform) data. One writer
+*  (monitor thread) fills the back buffer and publishes it, one reader
+*  (rt thread) picks up the latest published buffer. Both sides are
+*  wait free and the data is stored in the native element type (no
+*  conversion in the monitor thread).
+*
+\*************************************************************************/
+
+#ifndef ECMC_PV_ARRAY_BUFFER_H_
+#define ECMC_PV_ARRAY_BUFFER_H_
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ECMC_PV_ARRAY_BUFFER_COUNT 3
+#define ECMC_PV_ARRAY_BUFFER_FRESH 0x4
+#define ECMC_PV_ARRAY_BUFFER_INDEX 0x3
+
+class ecmcPvArrayBuffer {
+ public:
+  // Capacity in elements, element size in bytes
+  ecmcPvArrayBuffer(size_t capacity, size_t maxElementSize):
+        capacity_(capacity),
+        writeIndex_(0),
+        readIndex_(1),
+        middle_(2)
+  {
+    for(int i = 0; i < ECMC_PV_ARRAY_BUFFER_COUNT; ++i) {
+      data_[i]  = new uint8_t[capacity * maxElementSize];
+      count_[i] = 0;
+    }
+  }
+
+  ~ecmcPvArrayBuffer() {
+    for(int i = 0; i < ECMC_PV_ARRAY_BUFFER_COUNT; ++i) {
+      delete[] data_[i];
+    }
+  }
+
+  size_t getCapacity() {
+    return capacity_;
+  }
+
+  // Writer: buffer to fill (capacity elements)
+  void* getWriteBuffer() {
+    return data_[writeIndex_];
+  }
+
+  // Writer: make filled buffer available to reader
+  void publish(size_t count) {
+    count_[writeIndex_] = count;
+    int prev = middle_.exchange(writeIndex_ | ECMC_PV_ARRAY_BUFFER_FRESH,
+                                std::memory_order_acq_rel);
+    writeIndex_ = prev & ECMC_PV_ARRAY_BUFFER_INDEX;
+  }
+
+  // Reader: latest published data (valid until next call)
+  const void* read(size_t *count) {
+    update();
+    return peek(count);
+  }
+
+  // Reader: take latest published buffer (if any new)
+  void update() {
+    if(middle_.load(std::memory_order_relaxed) & ECMC_PV_ARRAY_BUFFER_FRESH) {
+      int prev = middle_.exchange(readIndex_, std::memory_order_acq_rel);
+      readIndex_ = prev & ECMC_PV_ARRAY_BUFFER_INDEX;
+    }
+  }
+
+  // Reader: data taken by last update() (valid until next update())
+  const void* peek(size_t *count) {
+    *count = count_[readIndex_];
+    return data_[readIndex_];
+  }
+
+ private:
+  size_t           capacity_;
+  uint8_t         *data_[ECMC_PV_ARRAY_BUFFER_COUNT];
+  size_t           count_[ECMC_PV_ARRAY_BUFFER_COUNT];
+  int              writeIndex_;  // Only accessed by writer
+  int              readIndex_;   // Only accessed by reader
+  std::atomic<int> middle_;
+};
+
+#endif  /* ECMC_PV_ARRAY_BUFFER_H_ */
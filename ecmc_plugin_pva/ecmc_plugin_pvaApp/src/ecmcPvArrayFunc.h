@@ -0,0 +1,79 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcPvArrayFunc.h
+*
+*  Created on: Oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+
+#ifndef ECMC_PV_ARRAY_FUNC_H_
+#define ECMC_PV_ARRAY_FUNC_H_
+
+#include "exprtk.hpp"
+#include "ecmcPvaWrap.h"
+#include "ecmcPvDefs.h"
+
+// class for exprtk count=pv_get_array(<handle>, <vector>) command
+template <typename T>
+struct pvgetarray : public exprtk::igeneric_function<T>
+{
+public:
+
+  typedef typename exprtk::igeneric_function<T> igfun_t;
+  typedef typename igfun_t::parameter_list_t    parameter_list_t;
+  typedef typename igfun_t::generic_type        generic_type;
+  typedef typename generic_type::scalar_view    scalar_t;
+  typedef typename generic_type::vector_view    vector_t;
+
+  using exprtk::igeneric_function<T>::operator();
+
+  pvgetarray()
+  : exprtk::igeneric_function<T>("TV")
+  {}
+
+  inline T operator()(parameter_list_t parameters)
+  {
+    scalar_t handle(parameters[0]);
+    vector_t data(parameters[1]);
+    return T(getLastArray((int)handle(), &data[0], (int)data.size()));
+  }
+};
+
+// class for exprtk error=pv_put_array(<handle>, <vector>[, <count>]) command
+template <typename T>
+struct pvputarray : public exprtk::igeneric_function<T>
+{
+public:
+
+  typedef typename exprtk::igeneric_function<T> igfun_t;
+  typedef typename igfun_t::parameter_list_t    parameter_list_t;
+  typedef typename igfun_t::generic_type        generic_type;
+  typedef typename generic_type::scalar_view    scalar_t;
+  typedef typename generic_type::vector_view    vector_t;
+
+  using exprtk::igeneric_function<T>::operator();
+
+  pvputarray()
+  : exprtk::igeneric_function<T>("TV|TVT")
+  {}
+
+  inline T operator()(const std::size_t& ps_index, parameter_list_t parameters)
+  {
+    scalar_t handle(parameters[0]);
+    vector_t data(parameters[1]);
+    int count = (int)data.size();
+    if(ps_index == 1) {
+      scalar_t countParam(parameters[2]);
+      if(countParam() >= 0 && countParam() < count) {
+        count = (int)countParam();
+      }
+    }
+    return T(exePutArrayCmd((int)handle(), &data[0], count));
+  }
+};
+
+#endif  /* ECMC_PV_ARRAY_FUNC_H_ */
@@ -0,0 +1,289 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcPvCmdDispatcher.cpp
+*
+*  Created on: Oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+
+#include <stdexcept>
+#include <stdio.h>
+#include "ecmcPvCmdDispatcher.h"
+
+// Start worker threads of dispatcher
+void f_worker_exe(void *obj) {
+  if(!obj) {
+    printf("%s/%s:%d: Error: Worker thread dispatcher object NULL..\n",
+            __FILE__, __FUNCTION__, __LINE__);
+    return;
+  }
+
+  ecmcPvCmdDispatcher * dispObj = (ecmcPvCmdDispatcher*)obj;
+  dispObj->exeWorkerThread();
+}
+
+ecmcPvCmdDispatcher::ecmcPvCmdDispatcher(int workerCount, int queueSize):
+      workerCount_(0),
+      queueSize_(queueSize),
+      queueMask_(0),
+      queue_(NULL),
+      queueTail_(0),
+      queueHead_(0),
+      idleWorkers_(0),
+      destructs_(false),
+      queueFullReported_(false),
+      batchActive_(false),
+      batchThread_(NULL),
+      batch_(NULL),
+      batchCount_(0),
+      workerThreads_(NULL),
+      workEvent_(NULL)
+{
+  if(workerCount <= 0 || queueSize <= 0) {
+    throw std::runtime_error("Error: Invalid worker thread count or queue size.");
+  }
+
+  size_t ringSize = 1;
+  while(ringSize < (size_t)queueSize_) {
+    ringSize <<= 1;
+  }
+  queueMask_ = ringSize - 1;
+  queue_     = new ecmcPvCmdQueueCell[ringSize];
+  for(size_t i = 0; i < ringSize; ++i) {
+    queue_[i].seq.store(i, std::memory_order_relaxed);
+    queue_[i].item  = NULL;
+    queue_[i].batch = false;
+  }
+  batch_         = new ecmcPvCmdItem*[queueSize_];
+  workerThreads_ = new epicsThreadId[workerCount];
+  workEvent_     = epicsEventCreate(epicsEventEmpty);
+  if(!workEvent_) {
+    throw std::runtime_error("Error: Create dispatcher event failed.");
+  }
+
+  epicsThreadOpts opts = EPICS_THREAD_OPTS_INIT;
+  opts.priority  = 0;
+  opts.stackSize = 32768;
+  opts.joinable  = 1;
+  char threadname[32];
+  for(int i = 0; i < workerCount; ++i) {
+    snprintf(threadname, sizeof(threadname), "ecmc.pva.cmd%d", i);
+    workerThreads_[i] = epicsThreadCreateOpt(threadname, f_worker_exe, this, &opts);
+    if(workerThreads_[i] == NULL) {
+      throw std::runtime_error("Error: Failed create cmd exe worker thread.");
+    }
+    workerCount_++;
+  }
+}
+
+ecmcPvCmdDispatcher::~ecmcPvCmdDispatcher() {
+  destructs_ = true;
+  for(int i = 0; i < workerCount_; ++i) {
+    epicsEventSignal(workEvent_);
+  }
+  for(int i = 0; i < workerCount_; ++i) {
+    epicsThreadMustJoin(workerThreads_[i]);
+  }
+  if(workEvent_) {
+    epicsEventDestroy(workEvent_);
+  }
+  delete[] workerThreads_;
+  delete[] queue_;
+  delete[] batch_;
+}
+
+int ecmcPvCmdDispatcher::getWorkerCount() {
+  return workerCount_;
+}
+
+int ecmcPvCmdDispatcher::schedule(ecmcPvCmdItem *item) {
+  int state = item->dispatchState_.load();
+  while(true) {
+    switch(state) {
+      case ECMC_PV_DISPATCH_IDLE:
+        if(item->dispatchState_.compare_exchange_weak(state, ECMC_PV_DISPATCH_QUEUED)) {
+          if(stage(item)) {
+            return 0;
+          }
+          if(!push(item, false)) {
+            item->dispatchState_.store(ECMC_PV_DISPATCH_IDLE);
+            return -1;
+          }
+          wakeWorker();
+          return 0;
+        }
+        break;
+      case ECMC_PV_DISPATCH_RUNNING:
+        // Executed again by the same worker when the current run is done
+        if(item->dispatchState_.compare_exchange_weak(state, ECMC_PV_DISPATCH_RERUN)) {
+          return 0;
+        }
+        break;
+      default:
+        // Already queued
+        return 0;
+    }
+  }
+}
+
+// Keep item in batch if the calling thread has an open batch
+bool ecmcPvCmdDispatcher::stage(ecmcPvCmdItem *item) {
+  if(!batchActive_.load(std::memory_order_relaxed) ||
+     epicsThreadGetIdSelf() != batchThread_.load(std::memory_order_relaxed) ||
+     batchCount_ >= queueSize_) {
+    return false;
+  }
+  batch_[batchCount_++] = item;
+  return true;
+}
+
+int ecmcPvCmdDispatcher::beginBatch() {
+  if(batchActive_) {
+    return 0;
+  }
+  batchThread_ = epicsThreadGetIdSelf();
+  batchCount_  = 0;
+  batchActive_ = true;
+  return 0;
+}
+
+int ecmcPvCmdDispatcher::commitBatch() {
+  if(!batchActive_ || epicsThreadGetIdSelf() != batchThread_) {
+    return 0;
+  }
+  batchActive_ = false;
+  if(batchCount_ == 0) {
+    return 0;
+  }
+
+  int pushed = 0;
+  while(pushed < batchCount_ && push(batch_[pushed], true)) {
+    pushed++;
+  }
+  wakeWorker();
+
+  // Can not happen since each item is queued at most once (queue size = pv count)
+  int count = batchCount_;
+  for(int i = pushed; i < count; ++i) {
+    batch_[i]->dispatchState_.store(ECMC_PV_DISPATCH_IDLE);
+  }
+  batchCount_ = 0;
+  return pushed < count ? -1 : pushed;
+}
+
+// Any thread: returns false if the ring is full
+bool ecmcPvCmdDispatcher::push(ecmcPvCmdItem *item, bool batch) {
+  size_t pos = queueTail_.load(std::memory_order_relaxed);
+  ecmcPvCmdQueueCell *cell;
+  while(true) {
+    cell = &queue_[pos & queueMask_];
+    size_t seq = cell->seq.load(std::memory_order_acquire);
+    ptrdiff_t diff = (ptrdiff_t)seq - (ptrdiff_t)pos;
+    if(diff == 0) {
+      if(queueTail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if(diff < 0) {
+      return false;  // Full
+    } else {
+      pos = queueTail_.load(std::memory_order_relaxed);
+    }
+  }
+  cell->item  = item;
+  cell->batch = batch;
+  cell->seq.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+// Worker threads: returns NULL if the ring is empty
+ecmcPvCmdItem* ecmcPvCmdDispatcher::pop() {
+  size_t pos = queueHead_.load(std::memory_order_relaxed);
+  ecmcPvCmdQueueCell *cell;
+  while(true) {
+    cell = &queue_[pos & queueMask_];
+    size_t seq = cell->seq.load(std::memory_order_acquire);
+    ptrdiff_t diff = (ptrdiff_t)seq - (ptrdiff_t)(pos + 1);
+    if(diff == 0) {
+      if(queueHead_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if(diff < 0) {
+      return NULL;  // Empty
+    } else {
+      pos = queueHead_.load(std::memory_order_relaxed);
+    }
+  }
+  ecmcPvCmdItem *item = cell->item;
+  bool batch = cell->batch;
+  cell->seq.store(pos + queueMask_ + 1, std::memory_order_release);
+
+  // Wake another worker if more work is waiting (a batch is executed
+  // back-to-back by this worker)
+  if(!batch && pending()) {
+    wakeWorker();
+  }
+  return item;
+}
+
+// Item ready at head of ring
+bool ecmcPvCmdDispatcher::pending() {
+  size_t pos = queueHead_.load(std::memory_order_relaxed);
+  return queue_[pos & queueMask_].seq.load(std::memory_order_acquire) == pos + 1;
+}
+
+// Signal only if a worker waits, busy workers check the ring before waiting.
+// The fences pair with the fence in exeWorkerThread() (no lost wakeup).
+void ecmcPvCmdDispatcher::wakeWorker() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if(idleWorkers_.load(std::memory_order_relaxed) > 0) {
+    epicsEventSignal(workEvent_);
+  }
+}
+
+void ecmcPvCmdDispatcher::exeWorkerThread() {
+  while(true) {
+    idleWorkers_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(!pending() && !destructs_) {
+      epicsEventWait(workEvent_);
+    }
+    idleWorkers_.fetch_sub(1, std::memory_order_relaxed);
+    if(destructs_) {
+      // Signals may have been merged (binary event), wake next worker
+      epicsEventSignal(workEvent_);
+      return;
+    }
+
+    ecmcPvCmdItem *item = NULL;
+    while((item = pop()) != NULL) {
+      while(true) {
+        item->dispatchState_.store(ECMC_PV_DISPATCH_RUNNING);
+        item->exeCmd();
+        int state = ECMC_PV_DISPATCH_RUNNING;
+        if(item->dispatchState_.compare_exchange_strong(state, ECMC_PV_DISPATCH_IDLE)) {
+          break;
+        }
+        // New command arrived while executing, queue again (keeps order per item)
+        item->dispatchState_.store(ECMC_PV_DISPATCH_QUEUED);
+        if(push(item, false)) {
+          wakeWorker();
+          break;
+        }
+        // Queue full (more items than queue size): execute again here, an
+        // item left queued would never be scheduled again
+        if(!queueFullReported_) {
+          printf("%s: Error: Dispatcher queue full (size %d), re-executing item in worker.\n",
+                 __FILE__, queueSize_);
+          queueFullReported_ = true;
+        }
+      }
+      if(destructs_) {
+        return;
+      }
+    }
+  }
+}
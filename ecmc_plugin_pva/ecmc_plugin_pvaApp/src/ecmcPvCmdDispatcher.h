@@ -0,0 +1,99 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcPvCmdDispatcher.h
+*
+*  Created on: Oct 17, 2026
+*      Author: anderssandstrom
+*
+*  Shared pool of worker threads executing async pv commands
+*  (pv_reg_asyn(), pv_put_asyn()). Items are queued when they have a
+*  command pending and any worker can execute any item. An item is
+*  never executed by two workers at the same time, so the commands
+*  of one pv are always executed in order.
+*  Items scheduled by one thread between beginBatch() and commitBatch()
+*  are handed to the workers with one wakeup and executed back-to-back by
+*  the woken worker.
+*  The queue is a bounded lock free ring (sequence number per cell), so
+*  scheduling never waits for a worker holding a lock. A worker is only
+*  woken (epicsEventSignal(), short internal lock of the event) if one is
+*  idle. Busy workers take new items before they wait again.
+*
+\*************************************************************************/
+
+#ifndef ECMC_PV_CMD_DISPATCHER_H_
+#define ECMC_PV_CMD_DISPATCHER_H_
+
+#include <atomic>
+#include <stddef.h>
+#include "epicsThread.h"
+#include "epicsEvent.h"
+
+enum ecmc_pv_dispatch_state {
+  ECMC_PV_DISPATCH_IDLE    = 0,
+  ECMC_PV_DISPATCH_QUEUED  = 1,
+  ECMC_PV_DISPATCH_RUNNING = 2,
+  ECMC_PV_DISPATCH_RERUN   = 3
+};
+
+// Base for objects that can be scheduled on the dispatcher
+class ecmcPvCmdItem {
+ public:
+  ecmcPvCmdItem() : dispatchState_(ECMC_PV_DISPATCH_IDLE) {}
+  virtual ~ecmcPvCmdItem() {}
+  // Executed in one of the worker threads
+  virtual void exeCmd() = 0;
+
+ private:
+  friend class ecmcPvCmdDispatcher;
+  std::atomic<int> dispatchState_;
+};
+
+// Cell of queue ring: seq == pos (free for push at pos), pos + 1 (filled)
+struct ecmcPvCmdQueueCell {
+  std::atomic<size_t> seq;
+  ecmcPvCmdItem      *item;
+  bool                batch;  // Pushed by commitBatch()
+};
+
+class ecmcPvCmdDispatcher {
+ public:
+  // queueSize: max number of items (each item is queued at most once)
+  ecmcPvCmdDispatcher(int workerCount, int queueSize);
+  ~ecmcPvCmdDispatcher();
+  // Queue item for execution (lock free queue, never waits, safe to call from rt)
+  int  schedule(ecmcPvCmdItem *item);
+  // Stage items scheduled by calling thread until commitBatch()
+  int  beginBatch();
+  // Returns number of items handed to workers or -1 if queue full
+  int  commitBatch();
+  int  getWorkerCount();
+  void exeWorkerThread();
+
+ private:
+  bool           push(ecmcPvCmdItem *item, bool batch);
+  ecmcPvCmdItem* pop();
+  bool           pending();
+  void           wakeWorker();
+  bool           stage(ecmcPvCmdItem *item);
+
+  int             workerCount_;
+  int             queueSize_;
+  size_t          queueMask_;    // Ring size - 1 (power of 2 >= queueSize_)
+  ecmcPvCmdQueueCell *queue_;
+  std::atomic<size_t> queueTail_;  // Next push position
+  std::atomic<size_t> queueHead_;  // Next pop position
+  std::atomic<int>  idleWorkers_;  // Workers waiting (or about to) for work
+  std::atomic<bool> destructs_;  // Set by destructor, read by workers
+  std::atomic<bool> queueFullReported_;
+  std::atomic<bool> batchActive_;
+  std::atomic<epicsThreadId> batchThread_;
+  ecmcPvCmdItem **batch_;
+  int             batchCount_;
+  epicsThreadId  *workerThreads_;
+  epicsEventId    workEvent_;
+};
+
+#endif  /* ECMC_PV_CMD_DISPATCHER_H_ */
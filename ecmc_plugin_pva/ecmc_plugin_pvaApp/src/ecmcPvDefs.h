@@ -16,6 +16,21 @@
 #define ECMC_IOC_STARTED_STATE 16
 
 #define ECMC_MAX_PVS_DEFAULT 8
+#define ECMC_PV_INIT_PV_COUNT_DEFAULT 8
+#define ECMC_PV_WORKER_THREADS_DEFAULT 2
+#define ECMC_PV_MAX_ARRAY_SIZE_DEFAULT 1024
+#define ECMC_PV_NAME_MAX_LEN 128
+#define ECMC_PV_ERR_REPORT_PERIOD_S 1.0
+#define ECMC_PV_CONNECT_TIMEOUT_DEFAULT 5.0
+#define ECMC_PV_CONNECT_POLL_PERIOD_S 0.01
+#define ECMC_PV_PROVIDER_DEFAULT "pva"
+#define ECMC_PV_RECONNECT_DELAY_DEFAULT 1.0
+#define ECMC_PV_RECONNECT_DELAY_MAX_DEFAULT 30.0
+
+// Returned by pv_severity() if no valid value (not connected)
+#define ECMC_PV_SEVERITY_INVALID 3
+// Returned by pv_age() if no valid value (not connected)
+#define ECMC_PV_AGE_INVALID INT64_MAX
 
 #define ECMC_PV_REG_ERROR 1
 #define ECMC_PV_GET_ERROR 2
@@ -27,15 +42,93 @@
 #define ECMC_PV_TYPE_NOT_SUPPORTED 8
 #define ECMC_PV_NOT_CONNECTED 9
 #define ECMC_PV_INIT_ERROR 10
+#define ECMC_PV_NOT_REGISTERED 11
+#define ECMC_PV_READ_ONLY 12
+
+// pv_stat() ids (see ecmcPvStats.h)
+#define ECMC_PV_STAT_PUT_COUNT           0   // Puts issued
+#define ECMC_PV_STAT_PUT_LATENCY_AVG     1   // Put issued to putDone() [us]
+#define ECMC_PV_STAT_PUT_LATENCY_MAX     2
+#define ECMC_PV_STAT_EVENT_COUNT         3   // Monitor events
+#define ECMC_PV_STAT_EVENT_RATE          4   // Monitor events [Hz]
+#define ECMC_PV_STAT_VISIBLE_LATENCY_AVG 5   // Monitor event to first rt read [us]
+#define ECMC_PV_STAT_VISIBLE_LATENCY_MAX 6
+#define ECMC_PV_STAT_COALESCED_COUNT     7   // pv_put_latest() values overwritten
+#define ECMC_PV_STAT_OVERRUN_COUNT       8   // Monitor overruns (server side)
+#define ECMC_PV_STAT_BUSY_COUNT          9   // Async cmds rejected (busy)
+#define ECMC_PV_STAT_RECONNECT_COUNT     10
+#define ECMC_PV_STAT_FILTERED_COUNT      11  // Monitor values dropped by deadband
+#define ECMC_PV_STAT_QUEUE_DEPTH_MAX     12  // Max monitor elements drained in one event
+#define ECMC_PV_STAT_SKIPPED_COUNT       13  // Monitor elements skipped (DRAIN_LAST)
+#define ECMC_PV_STAT_FAST_RECONNECT_COUNT 14  // Reconnects with cached type (not validated again)
+#define ECMC_PV_STAT_RETRY_COUNT         15  // Failed channels recreated (RECONNECT_DELAY)
+
+// pv_state() values (low byte of state word, see ecmcPvHotState)
+#define ECMC_PV_STATE_UNREGISTERED 0  // Free handle or unregistered
+#define ECMC_PV_STATE_REGISTERING  1  // Reg cmd queued
+#define ECMC_PV_STATE_CONNECTING   2  // Channel created, not connected yet
+#define ECMC_PV_STATE_CONNECTED    3  // Channel connected, no monitor data yet
+#define ECMC_PV_STATE_TYPED        4  // Monitor data of supported type (pv_connected())
+#define ECMC_PV_STATE_DISCONNECTED 5  // Connection lost (reconnected by pvAccess)
+#define ECMC_PV_STATE_ERROR        6  // Register failed, monitor failed or type not supported
+#define ECMC_PV_STATE_MASK         0xff
+#define ECMC_PV_STATE_BUSY         0x100  // Async cmd executing (pv_busy())
+#define ECMC_PV_STATE_VALUE        0x200  // Typed since registration (last value, SERVE_LAST)
 
 #define ECMC_PV_PLC_CMD_PV_REG_ASYN "pv_reg_asyn"
+#define ECMC_PV_PLC_CMD_PV_UNREG_ASYN "pv_unreg_asyn"
 #define ECMC_PV_PLC_CMD_PV_PUT_ASYN "pv_put_asyn"
 #define ECMC_PV_PLC_CMD_PV_GET_VALUE "pv_get"
 #define ECMC_PV_PLC_CMD_PV_GET_BUSY "pv_busy"
 #define ECMC_PV_PLC_CMD_PV_GET_ERR "pv_err"
 #define ECMC_PV_PLC_CMD_PV_GET_CONNECTED "pv_connected"
+#define ECMC_PV_PLC_CMD_PV_GET_ARRAY "pv_get_array"
+#define ECMC_PV_PLC_CMD_PV_PUT_ARRAY "pv_put_array"
+#define ECMC_PV_PLC_CMD_PV_PUT_LATEST "pv_put_latest"
+#define ECMC_PV_PLC_CMD_PV_PUT_COALESCED "pv_put_coalesced"
+#define ECMC_PV_PLC_CMD_PV_BATCH_BEGIN "pv_batch_begin"
+#define ECMC_PV_PLC_CMD_PV_BATCH_COMMIT "pv_batch_commit"
+#define ECMC_PV_PLC_CMD_PV_STAT "pv_stat"
+#define ECMC_PV_PLC_CMD_PV_STAT_RESET "pv_stat_reset"
+#define ECMC_PV_PLC_CMD_PV_GET_INT64 "pv_get_int64"
+#define ECMC_PV_PLC_CMD_PV_PUT_INT64 "pv_put_int64"
+#define ECMC_PV_PLC_CMD_PV_GET_SEVERITY "pv_severity"
+#define ECMC_PV_PLC_CMD_PV_GET_AGE "pv_age"
+#define ECMC_PV_PLC_CMD_PV_GET_UPDATES "pv_updates"
+#define ECMC_PV_PLC_CMD_PV_GET_STATE "pv_state"
+#define ECMC_PV_PLC_CMD_PV_GET_STALE "pv_stale"
 
 #define ECMC_PV_OPTION_MAX_PV_COUNT "MAX_PV_COUNT"
+#define ECMC_PV_OPTION_INIT_PV_COUNT "INIT_PV_COUNT"
+#define ECMC_PV_OPTION_WORKER_THREADS "WORKER_THREADS"
+#define ECMC_PV_OPTION_MAX_ARRAY_SIZE "MAX_ARRAY_SIZE"
+#define ECMC_PV_OPTION_SNAPSHOT "SNAPSHOT"
+#define ECMC_PV_OPTION_ALARM_TIMESTAMP "ALARM_TIMESTAMP"
+#define ECMC_PV_OPTION_BACKEND "BACKEND"
+#define ECMC_PV_OPTION_PV "PV"
+#define ECMC_PV_OPTION_PV_FILE "PV_FILE"
+#define ECMC_PV_OPTION_CONNECT_TIMEOUT "CONNECT_TIMEOUT"
+#define ECMC_PV_OPTION_RECONNECT_DELAY "RECONNECT_DELAY"
+#define ECMC_PV_OPTION_RECONNECT_DELAY_MAX "RECONNECT_DELAY_MAX"
+#define ECMC_PV_OPTION_SERVE_LAST "SERVE_LAST"
+
+// Values of BACKEND option (config and pv_reg_asyn())
+#define ECMC_PV_BACKEND_NAME_PVACLIENT "pvaClient"
+#define ECMC_PV_BACKEND_NAME_PVAC "pvac"
+
+// Options of pv_reg_asyn() (optional third argument)
+#define ECMC_PV_REG_OPTION_QUEUE_SIZE "QUEUE_SIZE"
+#define ECMC_PV_REG_OPTION_PIPELINE "PIPELINE"
+#define ECMC_PV_REG_OPTION_FIELDS "FIELDS"
+#define ECMC_PV_REG_OPTION_DEADBAND "DEADBAND"
+#define ECMC_PV_REG_OPTION_DEADBAND_REL "DEADBAND_REL"
+#define ECMC_PV_REG_OPTION_DRAIN_LAST "DRAIN_LAST"
+#define ECMC_PV_REG_OPTION_READ_ONLY "READ_ONLY"
+#define ECMC_PV_REG_OPTION_BACKEND "BACKEND"
+#define ECMC_PV_REG_OPTION_SHARE "SHARE"
+
+// Request of put (monitor request set by pv_reg_asyn())
+#define ECMC_PV_PUT_REQUEST "value"
 
 
 #endif  /* ECMC_PV_DEFS_H_ */
@@ -0,0 +1,256 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcPvHotTable.h
+*
+*  Created on: Oct 17, 2026
+*      Author: anderssandstrom
+*
+*  State read by the rt thread, indexed by slot (handle - 1) and kept
+*  apart from the pv objects (names, client objects, stats). The table
+*  is a structure of arrays allocated once for MAX_PV_COUNT slots:
+*  * states   : state word and source slot (packed, 4 per cache line),
+*               scanned by pv_connected(), pv_busy() and pv_get()
+*  * values   : value published by the monitor (one per cache line pair,
+*               monitors of different pvs run in different threads)
+*  * snapshot : values used by the plcs in this cycle (SNAPSHOT=1)
+*  A plc scanning many pvs then reads a few consecutive cache lines
+*  instead of one pv object per handle.
+*
+\*************************************************************************/
+
+#ifndef ECMC_PV_HOT_TABLE_H_
+#define ECMC_PV_HOT_TABLE_H_
+
+#include <atomic>
+#include <new>
+#include <stdint.h>
+#include "epicsTime.h"
+#include "ecmcPvDefs.h"
+#include "ecmcPvSeqLock.h"
+#include "ecmcPvStats.h"
+
+#define ECMC_PV_CACHE_LINE_SIZE 64
+
+// Native storage of scalar values (chosen once at connect, see validateType())
+enum ecmc_pv_value_kind {
+  ECMC_PV_VALUE_DOUBLE = 0,  // float, double
+  ECMC_PV_VALUE_INT64  = 1,  // boolean, signed, unsigned <= 32 bit, enum index
+  ECMC_PV_VALUE_UINT64 = 2,  // ulong
+  ECMC_PV_VALUE_ARRAY  = 3   // Only alarm/timeStamp (data in ecmcPvArrayBuffer)
+};
+
+// Value published by monitor to rt
+struct ecmcPvValue {
+  union {
+    double   d;
+    int64_t  i;
+    uint64_t u;
+  };
+  uint64_t eventNs;      // epicsMonotonicGet() at monitor event
+  uint64_t updateCount;  // Number of values published by monitor
+  int64_t  stampNs;      // timeStamp [ns posix epoch], 0 if not requested
+  int32_t  severity;     // alarm.severity, 0 if not requested
+  int32_t  kind;         // ecmc_pv_value_kind of union
+};
+
+// Per slot state read by rt. The state word holds the connection state
+// (ECMC_PV_STATE_*, written for all handles of a channel by the slot owning
+// it), the busy bit and the value bit, so each rt check is a single acquire
+// load.
+struct ecmcPvHotState {
+  std::atomic<uint32_t> state;          // ECMC_PV_STATE_* | BUSY | VALUE
+  std::atomic<int>      source;         // Slot owning channel and value (own slot if not shared)
+  uint64_t              rtLastEventNs;  // Last value seen by rt (visible latency), rt only
+
+  uint32_t get() const {
+    return state.load(std::memory_order_acquire) & ECMC_PV_STATE_MASK;
+  }
+
+  bool busy() const {
+    return (state.load(std::memory_order_acquire) & ECMC_PV_STATE_BUSY) != 0;
+  }
+
+  // Returns false if already busy
+  bool lockBusy() {
+    return !(state.fetch_or(ECMC_PV_STATE_BUSY, std::memory_order_acq_rel) &
+             ECMC_PV_STATE_BUSY);
+  }
+
+  void clearBusy() {
+    state.fetch_and(~(uint32_t)ECMC_PV_STATE_BUSY, std::memory_order_release);
+  }
+
+  // Typed before, now reconnecting (last value kept, see SERVE_LAST)
+  static bool stale(uint32_t word) {
+    uint32_t state = word & ECMC_PV_STATE_MASK;
+    return (word & ECMC_PV_STATE_VALUE) &&
+           (state == ECMC_PV_STATE_CONNECTING || state == ECMC_PV_STATE_CONNECTED ||
+            state == ECMC_PV_STATE_DISCONNECTED);
+  }
+
+  // Registration (rt) and unregistration: any state, busy bit kept (value
+  // bit cleared)
+  void set(uint32_t newState) {
+    uint32_t old = state.load(std::memory_order_relaxed);
+    while(!state.compare_exchange_weak(old, (old & ECMC_PV_STATE_BUSY) | newState,
+                                       std::memory_order_acq_rel)) {
+    }
+  }
+
+  // Channel transitions: not applied if the handle was unregistered meanwhile.
+  // Busy and value bits kept, value bit set when typed.
+  void update(uint32_t newState) {
+    uint32_t flags = newState == ECMC_PV_STATE_TYPED ? ECMC_PV_STATE_VALUE : 0;
+    uint32_t old = state.load(std::memory_order_relaxed);
+    do {
+      if((old & ECMC_PV_STATE_MASK) == ECMC_PV_STATE_UNREGISTERED) {
+        return;
+      }
+    } while(!state.compare_exchange_weak(old, (old & (ECMC_PV_STATE_BUSY | ECMC_PV_STATE_VALUE)) |
+                                              flags | newState,
+                                         std::memory_order_acq_rel));
+  }
+};
+
+// Value of slot owning a channel (written by monitor thread)
+struct alignas(ECMC_PV_CACHE_LINE_SIZE) ecmcPvHotValue {
+  ecmcPvSeqLock<ecmcPvValue> value;
+};
+
+// Snapshot mode (values taken at start of rt cycle, only accessed by rt)
+struct ecmcPvSnapshotEntry {
+  ecmcPvValue value;
+  int         error;
+};
+
+class ecmcPvHotTable {
+ public:
+  explicit ecmcPvHotTable(int count):
+        count_(count),
+        statesRaw_(NULL),
+        valuesRaw_(NULL),
+        snapshotRaw_(NULL),
+        visibleLatency_(NULL),
+        serveLast_(false)
+  {
+    states_   = allocAligned<ecmcPvHotState>(&statesRaw_);
+    values_   = allocAligned<ecmcPvHotValue>(&valuesRaw_);
+    snapshot_ = allocAligned<ecmcPvSnapshotEntry>(&snapshotRaw_);
+    visibleLatency_ = new ecmcPvLatencyHist*[count];
+    for(int i = 0; i < count; ++i) {
+      states_[i].state.store(ECMC_PV_STATE_UNREGISTERED);
+      states_[i].source.store(i);
+      states_[i].rtLastEventNs = 0;
+      snapshot_[i].value = ecmcPvValue();
+      snapshot_[i].error = ECMC_PV_NOT_CONNECTED;
+      visibleLatency_[i] = NULL;
+    }
+  }
+
+  ~ecmcPvHotTable() {
+    for(int i = 0; i < count_; ++i) {
+      states_[i].~ecmcPvHotState();
+      values_[i].~ecmcPvHotValue();
+    }
+    delete[] statesRaw_;
+    delete[] valuesRaw_;
+    delete[] snapshotRaw_;
+    delete[] visibleLatency_;
+  }
+
+  int getCount() {
+    return count_;
+  }
+
+  ecmcPvHotState& state(int index) {
+    return states_[index];
+  }
+
+  ecmcPvHotValue& value(int index) {
+    return values_[index];
+  }
+
+  ecmcPvSnapshotEntry& snapshot(int index) {
+    return snapshot_[index];
+  }
+
+  // Before realtime (pv object of slot created)
+  void setVisibleLatency(int index, ecmcPvLatencyHist *hist) {
+    visibleLatency_[index] = hist;
+  }
+
+  // Before realtime (SERVE_LAST=1)
+  void setServeLast(bool serveLast) {
+    serveLast_ = serveLast;
+  }
+
+  // Put connected on first put (not part of connected)
+  bool connected(int index) {
+    return states_[index].get() == ECMC_PV_STATE_TYPED;
+  }
+
+  // Value returned by read(): connected, or reconnecting with SERVE_LAST=1
+  bool readable(int index) {
+    uint32_t word = states_[index].state.load(std::memory_order_acquire);
+    return (word & ECMC_PV_STATE_MASK) == ECMC_PV_STATE_TYPED ||
+           (serveLast_ && ecmcPvHotState::stale(word));
+  }
+
+  bool stale(int index) {
+    return ecmcPvHotState::stale(states_[index].state.load(std::memory_order_acquire));
+  }
+
+  bool busy(int index) {
+    return states_[index].busy();
+  }
+
+  uint32_t getState(int index) {
+    return states_[index].get();
+  }
+
+  // Rt: latest published value of the slot owning the channel
+  int read(int index, ecmcPvValue *value) {
+    if(!readable(index)) {
+      return ECMC_PV_NOT_CONNECTED;
+    }
+    ecmcPvHotState &state = states_[index];
+    *value = values_[state.source.load(std::memory_order_relaxed)].value.read();
+    // First read of a new value
+    if(value->eventNs != state.rtLastEventNs) {
+      state.rtLastEventNs = value->eventNs;
+      if(visibleLatency_[index]) {
+        visibleLatency_[index]->add(epicsMonotonicGet() - value->eventNs);
+      }
+    }
+    return 0;
+  }
+
+ private:
+  // Array of count_ entries starting at a cache line (raw: to delete)
+  template <typename T>
+  T* allocAligned(char **raw) {
+    *raw = new char[count_ * sizeof(T) + ECMC_PV_CACHE_LINE_SIZE];
+    uintptr_t addr = ((uintptr_t)*raw + ECMC_PV_CACHE_LINE_SIZE - 1) &
+                     ~(uintptr_t)(ECMC_PV_CACHE_LINE_SIZE - 1);
+    T *array = (T*)addr;
+    for(int i = 0; i < count_; ++i) {
+      new (&array[i]) T();
+    }
+    return array;
+  }
+
+  int                  count_;
+  ecmcPvHotState      *states_;
+  ecmcPvHotValue      *values_;
+  ecmcPvSnapshotEntry *snapshot_;
+  char                *statesRaw_;
+  char                *valuesRaw_;
+  char                *snapshotRaw_;
+  ecmcPvLatencyHist  **visibleLatency_;  // Of pv object (cold, only on new value)
+  bool                 serveLast_;       // Last value returned while reconnecting
+};
+
+#endif  /* ECMC_PV_HOT_TABLE_H_ */
@@ -0,0 +1,471 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcPvLog.cpp
+*
+*  Created on: Oct 17, 2026
+*      Author: anderssandstrom
+*
+*  Ring buffer:
+*  A writer claims a ticket (head_.fetch_add()) and writes entry
+*  ticket % ECMC_PV_LOG_SIZE. The entry sequence is odd while written
+*  and 2*ticket+2 when complete. Readers validate the sequence before
+*  and after copying an entry, so writers never wait for readers (old
+*  entries are overwritten).
+*
+\*************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <atomic>
+#include <stdexcept>
+#include "epicsThread.h"
+#include "epicsEvent.h"
+#include "epicsTime.h"
+#include "iocsh.h"
+#include "ecmcPvLog.h"
+#include "ecmcPvDefs.h"
+
+#define ECMC_PV_LOG_MASK (ECMC_PV_LOG_SIZE - 1)
+
+struct ecmcPvLogEntry {
+  std::atomic<uint64_t> seq;
+  epicsTimeStamp        time;
+  int                   severity;
+  int                   handle;
+  unsigned int          suppressed;
+  char                  msg[ECMC_PV_LOG_MSG_LEN];
+};
+
+// Copy of entry owned by reader
+struct ecmcPvLogEntryData {
+  epicsTimeStamp time;
+  int            severity;
+  int            handle;
+  unsigned int   suppressed;
+  char           msg[ECMC_PV_LOG_MSG_LEN];
+};
+
+struct ecmcPvLogRate {
+  std::atomic<uint64_t>     windowStart;
+  std::atomic<unsigned int> count;
+  std::atomic<unsigned int> suppressed;
+};
+
+class ecmcPvLog {
+ public:
+  explicit ecmcPvLog(int pvCount);
+  ~ecmcPvLog();
+  void msgV(int severity, int handle, const char *prefix,
+            const char *format, va_list args);
+  void dump(int severity);
+  void clear();
+  void setLevel(int storeLevel, int consoleLevel);
+  void setPollFunc(ecmcPvLogPollFunc func, void *obj);
+  void stop();
+  void exeDrainThread();
+
+ private:
+  bool rateLimit(int handle, unsigned int *suppressed);
+  bool readEntry(uint64_t ticket, ecmcPvLogEntryData *data, bool *notReady);
+  void print(const ecmcPvLogEntryData &data);
+  void drain();
+
+  ecmcPvLogEntry        *ring_;
+  ecmcPvLogRate         *rate_;
+  int                    rateCount_;
+  std::atomic<uint64_t>  head_;
+  std::atomic<uint64_t>  clearMark_;
+  std::atomic<int>       storeLevel_;
+  std::atomic<int>       consoleLevel_;
+  uint64_t               drainCursor_;  // Drain thread (destructor once stopped)
+  uint64_t               lost_;         // Drain thread (destructor once stopped)
+  ecmcPvLogPollFunc      pollFunc_;
+  void                  *pollObj_;
+  bool                   destructs_;
+  epicsEventId           drainEvent_;
+  epicsThreadId          drainThread_;
+};
+
+static const char* sevrToString(int severity) {
+  switch(severity) {
+    case ECMC_PV_LOG_DEBUG:
+      return "DEBUG";
+    case ECMC_PV_LOG_INFO:
+      return "INFO";
+    case ECMC_PV_LOG_WARNING:
+      return "WARNING";
+    case ECMC_PV_LOG_ERROR:
+      return "ERROR";
+    default:
+      return "?";
+  }
+}
+
+void f_log_drain_exe(void *obj) {
+  if(!obj) {
+    printf("%s/%s:%d: Error: Log drain thread object NULL..\n",
+            __FILE__, __FUNCTION__, __LINE__);
+    return;
+  }
+  ((ecmcPvLog*)obj)->exeDrainThread();
+}
+
+ecmcPvLog::ecmcPvLog(int pvCount):
+      ring_(NULL),
+      rate_(NULL),
+      rateCount_(pvCount + 1),
+      head_(0),
+      clearMark_(0),
+      storeLevel_(ECMC_PV_LOG_INFO),
+      consoleLevel_(ECMC_PV_LOG_INFO),
+      drainCursor_(0),
+      lost_(0),
+      pollFunc_(NULL),
+      pollObj_(NULL),
+      destructs_(false),
+      drainEvent_(NULL),
+      drainThread_(NULL)
+{
+  ring_ = new ecmcPvLogEntry[ECMC_PV_LOG_SIZE];
+  for(int i = 0; i < ECMC_PV_LOG_SIZE; ++i) {
+    ring_[i].seq = 0;
+  }
+  rate_ = new ecmcPvLogRate[rateCount_];
+  for(int i = 0; i < rateCount_; ++i) {
+    rate_[i].windowStart = 0;
+    rate_[i].count = 0;
+    rate_[i].suppressed = 0;
+  }
+
+  drainEvent_ = epicsEventCreate(epicsEventEmpty);
+  if(!drainEvent_) {
+    throw std::runtime_error("Error: Create log event failed.");
+  }
+  epicsThreadOpts opts = EPICS_THREAD_OPTS_INIT;
+  opts.priority  = epicsThreadPriorityLow;
+  opts.stackSize = epicsThreadGetStackSize(epicsThreadStackSmall);
+  opts.joinable  = 1;
+  drainThread_ = epicsThreadCreateOpt("ecmc.pva.log", f_log_drain_exe, this, &opts);
+  if(!drainThread_) {
+    throw std::runtime_error("Error: Create log thread failed.");
+  }
+}
+
+ecmcPvLog::~ecmcPvLog() {
+  stop();
+  // Messages stored after stop()
+  drain();
+  if(drainEvent_) {
+    epicsEventDestroy(drainEvent_);
+  }
+  delete[] rate_;
+  delete[] ring_;
+}
+
+// Max ECMC_PV_LOG_RATE_LIMIT messages per handle and period
+bool ecmcPvLog::rateLimit(int handle, unsigned int *suppressed) {
+  if(handle < 0 || handle >= rateCount_) {
+    handle = 0;
+  }
+  ecmcPvLogRate &rate = rate_[handle];
+  uint64_t now   = epicsMonotonicGet();
+  uint64_t start = rate.windowStart.load(std::memory_order_relaxed);
+  if(now - start > (uint64_t)(ECMC_PV_LOG_RATE_PERIOD_S * 1e9)) {
+    if(rate.windowStart.compare_exchange_strong(start, now)) {
+      rate.count.store(0, std::memory_order_relaxed);
+    }
+  }
+  if(rate.count.fetch_add(1, std::memory_order_relaxed) >= ECMC_PV_LOG_RATE_LIMIT) {
+    rate.suppressed.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  *suppressed = rate.suppressed.exchange(0, std::memory_order_relaxed);
+  return false;
+}
+
+void ecmcPvLog::msgV(int severity, int handle, const char *prefix,
+                     const char *format, va_list args) {
+  if(severity < storeLevel_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  unsigned int suppressed = 0;
+  if(rateLimit(handle, &suppressed)) {
+    return;
+  }
+
+  uint64_t ticket = head_.fetch_add(1, std::memory_order_relaxed);
+  ecmcPvLogEntry &entry = ring_[ticket & ECMC_PV_LOG_MASK];
+  entry.seq.store(2 * ticket + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  epicsTimeGetCurrent(&entry.time);
+  entry.severity   = severity;
+  entry.handle     = handle;
+  entry.suppressed = suppressed;
+  int len = 0;
+  if(prefix) {
+    len = snprintf(entry.msg, sizeof(entry.msg), "%s: ", prefix);
+    if(len < 0 || len >= (int)sizeof(entry.msg)) {
+      len = 0;
+    }
+  }
+  vsnprintf(entry.msg + len, sizeof(entry.msg) - len, format, args);
+
+  entry.seq.store(2 * ticket + 2, std::memory_order_release);
+}
+
+// Returns false if entry is not ready yet (notReady) or was overwritten
+bool ecmcPvLog::readEntry(uint64_t ticket, ecmcPvLogEntryData *data, bool *notReady) {
+  ecmcPvLogEntry &entry = ring_[ticket & ECMC_PV_LOG_MASK];
+  uint64_t expected = 2 * ticket + 2;
+  uint64_t seq = entry.seq.load(std::memory_order_acquire);
+  *notReady = seq < expected;
+  if(seq != expected) {
+    return false;
+  }
+  data->time       = entry.time;
+  data->severity   = entry.severity;
+  data->handle     = entry.handle;
+  data->suppressed = entry.suppressed;
+  memcpy(data->msg, entry.msg, sizeof(data->msg));
+  data->msg[sizeof(data->msg) - 1] = '\0';
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return entry.seq.load(std::memory_order_relaxed) == expected;
+}
+
+void ecmcPvLog::print(const ecmcPvLogEntryData &data) {
+  char timeStr[40];
+  epicsTimeToStrftime(timeStr, sizeof(timeStr), "%Y/%m/%d %H:%M:%S.%03f", &data.time);
+  if(data.suppressed) {
+    printf("%s [%s] %s (%u similar suppressed)\n", timeStr,
+           sevrToString(data.severity), data.msg, data.suppressed);
+  } else {
+    printf("%s [%s] %s\n", timeStr, sevrToString(data.severity), data.msg);
+  }
+}
+
+void ecmcPvLog::drain() {
+  uint64_t head  = head_.load(std::memory_order_acquire);
+  uint64_t clear = clearMark_.load(std::memory_order_acquire);
+  if(drainCursor_ < clear) {
+    drainCursor_ = clear;
+  }
+  if(head - drainCursor_ > ECMC_PV_LOG_SIZE) {
+    lost_ += head - drainCursor_ - ECMC_PV_LOG_SIZE;
+    drainCursor_ = head - ECMC_PV_LOG_SIZE;
+  }
+
+  int consoleLevel = consoleLevel_.load(std::memory_order_relaxed);
+  ecmcPvLogEntryData data;
+  bool notReady = false;
+  while(drainCursor_ < head) {
+    if(!readEntry(drainCursor_, &data, &notReady)) {
+      if(notReady) {
+        break;  // Still written, try next time
+      }
+      lost_++;
+    } else if(data.severity >= consoleLevel) {
+      print(data);
+    }
+    drainCursor_++;
+  }
+
+  if(lost_) {
+    printf("Warning: ecmcPvLog: %lu messages lost (ring buffer overflow).\n",
+           (unsigned long)lost_);
+    lost_ = 0;
+  }
+}
+
+void ecmcPvLog::dump(int severity) {
+  uint64_t head  = head_.load(std::memory_order_acquire);
+  uint64_t first = clearMark_.load(std::memory_order_acquire);
+  if(head - first > ECMC_PV_LOG_SIZE) {
+    first = head - ECMC_PV_LOG_SIZE;
+  }
+  ecmcPvLogEntryData data;
+  bool notReady = false;
+  unsigned int count = 0;
+  for(uint64_t ticket = first; ticket < head; ++ticket) {
+    if(readEntry(ticket, &data, &notReady) && data.severity >= severity) {
+      print(data);
+      count++;
+    }
+  }
+  printf("ecmcPvLog: %u messages (%lu written in total).\n", count,
+         (unsigned long)head);
+}
+
+void ecmcPvLog::clear() {
+  clearMark_.store(head_.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+void ecmcPvLog::setLevel(int storeLevel, int consoleLevel) {
+  storeLevel_   = storeLevel;
+  consoleLevel_ = consoleLevel;
+}
+
+void ecmcPvLog::setPollFunc(ecmcPvLogPollFunc func, void *obj) {
+  pollObj_  = obj;
+  pollFunc_ = func;
+}
+
+// Last poll and drain, then join drain thread. Messages are still stored.
+void ecmcPvLog::stop() {
+  if(drainThread_) {
+    destructs_ = true;
+    epicsEventSignal(drainEvent_);
+    epicsThreadMustJoin(drainThread_);
+    drainThread_ = NULL;
+  }
+}
+
+void ecmcPvLog::exeDrainThread() {
+  double sincePoll = 0;
+  while(true) {
+    epicsEventWaitWithTimeout(drainEvent_, ECMC_PV_LOG_DRAIN_PERIOD_S);
+    sincePoll += ECMC_PV_LOG_DRAIN_PERIOD_S;
+    if((sincePoll >= ECMC_PV_ERR_REPORT_PERIOD_S || destructs_) && pollFunc_) {
+      pollFunc_(pollObj_);
+      sincePoll = 0;
+    }
+    drain();
+    if(destructs_) {
+      return;
+    }
+  }
+}
+
+static std::atomic<ecmcPvLog*> pvLog(NULL);
+static std::atomic<int>        pvLogUsers(0);  // Calls using pvLog
+
+// Pin log for one call (ecmcPvLogCleanup() waits until released)
+static ecmcPvLog *acquireLog() {
+  pvLogUsers.fetch_add(1);
+  ecmcPvLog *log = pvLog.load();
+  if(!log) {
+    pvLogUsers.fetch_sub(1);
+  }
+  return log;
+}
+
+static void releaseLog() {
+  pvLogUsers.fetch_sub(1);
+}
+
+/* iocsh: ecmcPvaLogDump [<severity>] */
+static const iocshArg logDumpArg0 = {"severity (0=debug, 1=info, 2=warning, 3=error)", iocshArgInt};
+static const iocshArg *const logDumpArgs[] = {&logDumpArg0};
+static const iocshFuncDef logDumpFuncDef = {"ecmcPvaLogDump", 1, logDumpArgs};
+static void logDumpCallFunc(const iocshArgBuf *args) {
+  ecmcPvLogDump(args[0].ival);
+}
+
+/* iocsh: ecmcPvaLogClear */
+static const iocshFuncDef logClearFuncDef = {"ecmcPvaLogClear", 0, NULL};
+static void logClearCallFunc(const iocshArgBuf *args) {
+  ecmcPvLogClear();
+}
+
+/* iocsh: ecmcPvaLogLevel <store severity> <console severity> */
+static const iocshArg logLevelArg0 = {"store severity", iocshArgInt};
+static const iocshArg logLevelArg1 = {"console severity", iocshArgInt};
+static const iocshArg *const logLevelArgs[] = {&logLevelArg0, &logLevelArg1};
+static const iocshFuncDef logLevelFuncDef = {"ecmcPvaLogLevel", 2, logLevelArgs};
+static void logLevelCallFunc(const iocshArgBuf *args) {
+  ecmcPvLogSetLevel(args[0].ival, args[1].ival);
+}
+
+int ecmcPvLogInit(int pvCount) {
+  static bool iocshRegistered = false;
+  if(pvLog.load()) {
+    return 0;
+  }
+  try {
+    pvLog = new ecmcPvLog(pvCount);
+  }
+  catch(std::exception &e) {
+    printf("Error: ecmcPvLog init: %s\n", e.what());
+    return ECMC_PV_INIT_ERROR;
+  }
+  if(!iocshRegistered) {
+    iocshRegister(&logDumpFuncDef, logDumpCallFunc);
+    iocshRegister(&logClearFuncDef, logClearCallFunc);
+    iocshRegister(&logLevelFuncDef, logLevelCallFunc);
+    iocshRegistered = true;
+  }
+  return 0;
+}
+
+void ecmcPvLogStop() {
+  ecmcPvLog *log = acquireLog();
+  if(log) {
+    log->stop();
+    releaseLog();
+  }
+}
+
+void ecmcPvLogCleanup() {
+  ecmcPvLog *log = pvLog.exchange(NULL);
+  if(!log) {
+    return;
+  }
+  // Calls that got the log before it was cleared
+  while(pvLogUsers.load() > 0) {
+    epicsThreadSleep(ECMC_PV_LOG_DRAIN_PERIOD_S);
+  }
+  // Prints remaining messages
+  delete log;
+}
+
+void ecmcPvLogSetPollFunc(ecmcPvLogPollFunc func, void *obj) {
+  ecmcPvLog *log = acquireLog();
+  if(log) {
+    log->setPollFunc(func, obj);
+    releaseLog();
+  }
+}
+
+void ecmcPvLogMsgV(int severity, int handle, const char *prefix,
+                   const char *format, va_list args) {
+  ecmcPvLog *log = acquireLog();
+  if(log) {
+    log->msgV(severity, handle, prefix, format, args);
+    releaseLog();
+  }
+}
+
+void ecmcPvLogMsg(int severity, int handle, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  ecmcPvLogMsgV(severity, handle, NULL, format, args);
+  va_end(args);
+}
+
+void ecmcPvLogDump(int severity) {
+  ecmcPvLog *log = acquireLog();
+  if(log) {
+    log->dump(severity);
+    releaseLog();
+  }
+}
+
+void ecmcPvLogClear() {
+  ecmcPvLog *log = acquireLog();
+  if(log) {
+    log->clear();
+    releaseLog();
+  }
+}
+
+void ecmcPvLogSetLevel(int storeLevel, int consoleLevel) {
+  ecmcPvLog *log = acquireLog();
+  if(log) {
+    log->setLevel(storeLevel, consoleLevel);
+    releaseLog();
+  }
+}
@@ -0,0 +1,61 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcPvLog.h
+*
+*  Created on: Oct 17, 2026
+*      Author: anderssandstrom
+*
+*  Asynchronous diagnostics log for the pva plugin:
+*  * Messages are written to a lock free ring buffer (any thread).
+*  * A low prio thread prints new messages to the console.
+*  * Messages are rate limited per pv (handle).
+*  * The ring keeps the latest messages for dump (iocsh:
+*    ecmcPvaLogDump, ecmcPvaLogClear, ecmcPvaLogLevel).
+*
+\*************************************************************************/
+
+#ifndef ECMC_PV_LOG_H_
+#define ECMC_PV_LOG_H_
+
+#include <stdarg.h>
+
+enum ecmc_pv_log_sevr {
+  ECMC_PV_LOG_DEBUG   = 0,
+  ECMC_PV_LOG_INFO    = 1,
+  ECMC_PV_LOG_WARNING = 2,
+  ECMC_PV_LOG_ERROR   = 3
+};
+
+#define ECMC_PV_LOG_SIZE          512   // Entries (power of 2)
+#define ECMC_PV_LOG_MSG_LEN       160
+#define ECMC_PV_LOG_RATE_LIMIT    5     // Messages per pv and period
+#define ECMC_PV_LOG_RATE_PERIOD_S 1.0
+#define ECMC_PV_LOG_DRAIN_PERIOD_S 0.1
+
+typedef void (*ecmcPvLogPollFunc)(void *obj);
+
+// pvCount: number of handles to rate limit (handle 0 is used for global msgs)
+int  ecmcPvLogInit(int pvCount);
+// Stop drain thread (last poll and print). Messages are still stored.
+void ecmcPvLogStop();
+// Print remaining messages and free log (after all threads using it stopped)
+void ecmcPvLogCleanup();
+
+// Called by drain thread every ECMC_PV_ERR_REPORT_PERIOD_S (collect rt errors)
+void ecmcPvLogSetPollFunc(ecmcPvLogPollFunc func, void *obj);
+
+void ecmcPvLogMsg(int severity, int handle, const char *format, ...)
+  __attribute__((format(printf, 3, 4)));
+void ecmcPvLogMsgV(int severity, int handle, const char *prefix,
+                   const char *format, va_list args);
+
+// Print all messages retained in ring (with at least severity)
+void ecmcPvLogDump(int severity);
+void ecmcPvLogClear();
+// Minimum severity to store / print to console
+void ecmcPvLogSetLevel(int storeLevel, int consoleLevel);
+
+#endif  /* ECMC_PV_LOG_H_ */
@@ -0,0 +1,172 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcPvPool.cpp
+*
+*  Created on: Oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+
+#include <stdexcept>
+#include <stdio.h>
+#include "ecmcPvPool.h"
+#include "ecmcPvLog.h"
+
+// Start grow thread of pool
+void f_pool_grow_exe(void *obj) {
+  if(!obj) {
+    printf("%s/%s:%d: Error: Grow thread pool object NULL..\n",
+            __FILE__, __FUNCTION__, __LINE__);
+    return;
+  }
+
+  ecmcPvPool * poolObj = (ecmcPvPool*)obj;
+  poolObj->exeGrowThread();
+}
+
+ecmcPvPool::ecmcPvPool(int maxCount,
+                       int initCount,
+                       ecmcPvCmdDispatcher *dispatcher,
+                       size_t maxArraySize,
+                       bool snapshotMode):
+      maxCount_(maxCount),
+      chunkCount_(0),
+      chunks_(NULL),
+      hot_(NULL),
+      capacity_(0),
+      growRequested_(false),
+      usedCount_(0),
+      dispatcher_(dispatcher),
+      maxArraySize_(maxArraySize),
+      snapshotMode_(snapshotMode),
+      destructs_(false),
+      growEvent_(NULL),
+      growThread_(NULL)
+{
+  if(maxCount <= 0 || !dispatcher) {
+    throw std::runtime_error("Error: Invalid pool size or dispatcher NULL.");
+  }
+
+  hot_ = new ecmcPvHotTable(maxCount);
+  chunkCount_ = (maxCount + ECMC_PV_POOL_CHUNK_SIZE - 1) / ECMC_PV_POOL_CHUNK_SIZE;
+  chunks_ = new std::atomic<ecmcPvPoolChunk*>[chunkCount_];
+  for(int i = 0; i < chunkCount_; ++i) {
+    chunks_[i].store(NULL);
+  }
+
+  // At least one chunk
+  do {
+    addChunk();
+  } while(capacity_.load() < initCount && capacity_.load() < maxCount_);
+
+  // No need to grow if all objects already allocated
+  if(capacity_.load() >= maxCount_) {
+    return;
+  }
+
+  growEvent_ = epicsEventCreate(epicsEventEmpty);
+  if(!growEvent_) {
+    throw std::runtime_error("Error: Create pool event failed.");
+  }
+  epicsThreadOpts opts = EPICS_THREAD_OPTS_INIT;
+  opts.priority  = epicsThreadPriorityLow;
+  opts.stackSize = 32768;
+  opts.joinable  = 1;
+  growThread_ = epicsThreadCreateOpt("ecmc.pva.pool", f_pool_grow_exe, this, &opts);
+  if(growThread_ == NULL) {
+    throw std::runtime_error("Error: Failed create pool grow thread.");
+  }
+}
+
+ecmcPvPool::~ecmcPvPool() {
+  destructs_ = true;
+  if(growThread_) {
+    epicsEventSignal(growEvent_);
+    epicsThreadMustJoin(growThread_);
+  }
+  if(growEvent_) {
+    epicsEventDestroy(growEvent_);
+  }
+  for(int i = 0; i < chunkCount_; ++i) {
+    delete chunks_[i].load();
+  }
+  delete[] chunks_;
+  delete hot_;
+}
+
+// Grow thread (or constructor): returns 0 or -1 if pool already at max
+int ecmcPvPool::addChunk() {
+  int capacity = capacity_.load(std::memory_order_relaxed);
+  if(capacity >= maxCount_) {
+    return -1;
+  }
+  int newCapacity = capacity + ECMC_PV_POOL_CHUNK_SIZE;
+  if(newCapacity > maxCount_) {
+    newCapacity = maxCount_;
+  }
+
+  ecmcPvPoolChunk *chunk = new ecmcPvPoolChunk;
+  for(int index = capacity; index < newCapacity; ++index) {
+    int i = index % ECMC_PV_POOL_CHUNK_SIZE;
+    // Handle is 1 higher than index to avoid 0
+    chunk->pvs[i] = ecmcPv::create("DummyName","DummyProvider","value",index+1,dispatcher_,
+                                   maxArraySize_, hot_);
+    chunk->pvs[i]->setSnapshotMode(snapshotMode_);
+  }
+
+  // Publish chunk before the new capacity (see get())
+  chunks_[capacity / ECMC_PV_POOL_CHUNK_SIZE].store(chunk, std::memory_order_release);
+  capacity_.store(newCapacity, std::memory_order_release);
+  return 0;
+}
+
+bool ecmcPvPool::belowLowWater(int capacity, int usedCount) {
+  if(capacity >= maxCount_) {
+    return false;
+  }
+  int lowWater = capacity * ECMC_PV_POOL_LOW_WATER_PERCENT / 100;
+  if(lowWater < ECMC_PV_POOL_CHUNK_SIZE) {
+    lowWater = ECMC_PV_POOL_CHUNK_SIZE;
+  }
+  return capacity - usedCount < lowWater;
+}
+
+void ecmcPvPool::checkGrow(int usedCount) {
+  usedCount_.store(usedCount, std::memory_order_relaxed);
+  if(!belowLowWater(capacity_.load(std::memory_order_relaxed), usedCount)) {
+    return;
+  }
+  if(!growRequested_.exchange(true)) {
+    epicsEventSignal(growEvent_);
+  }
+}
+
+// Adds chunks until the free objects are above the low water mark again
+// (a burst of registrations needs more than one chunk per request)
+void ecmcPvPool::exeGrowThread() {
+  while(true) {
+    epicsEventWait(growEvent_);
+    if(destructs_) {
+      return;
+    }
+    // Cleared first: a request made while growing signals again
+    growRequested_.store(false);
+    int capacity = capacity_.load();
+    try {
+      while(!destructs_ &&
+            belowLowWater(capacity_.load(), usedCount_.load(std::memory_order_relaxed)) &&
+            addChunk() == 0) {
+      }
+    }
+    catch(std::exception &e) {
+      ecmcPvLogMsg(ECMC_PV_LOG_ERROR, 0, "Pv pool grow failed: %s", e.what());
+    }
+    if(capacity_.load() > capacity) {
+      ecmcPvLogMsg(ECMC_PV_LOG_INFO, 0, "Pv pool grown to %d objects (max %d)",
+                   capacity_.load(), maxCount_);
+    }
+  }
+}
@@ -0,0 +1,97 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcPvPool.h
+*
+*  Created on: Oct 17, 2026
+*      Author: anderssandstrom
+*
+*  Pool of pv objects, allocated in chunks. The pool starts with
+*  INIT_PV_COUNT objects and grows (up to MAX_PV_COUNT) in a low prio
+*  thread when the free objects drop below the low water mark (checked
+*  before each registration), so the rt thread never allocates. Chunks are never moved or freed before
+*  destruction, so the handle to object lookup is a lock free two
+*  level table lookup (chunk directory sized for MAX_PV_COUNT).
+*  The state read by the rt thread lives in the hot table (allocated
+*  once for MAX_PV_COUNT slots, see ecmcPvHotTable.h), not in the chunks.
+*
+\*************************************************************************/
+
+#ifndef ECMC_PV_POOL_H_
+#define ECMC_PV_POOL_H_
+
+#include <atomic>
+#include "epicsThread.h"
+#include "epicsEvent.h"
+#include "ecmcPv.h"
+#include "ecmcPvCmdDispatcher.h"
+#include "ecmcPvHotTable.h"
+
+#define ECMC_PV_POOL_CHUNK_SIZE 8
+// Grow while less than this part of the capacity (at least one chunk) is free
+#define ECMC_PV_POOL_LOW_WATER_PERCENT 25
+
+struct ecmcPvPoolChunk {
+  ecmcPvPtr           pvs[ECMC_PV_POOL_CHUNK_SIZE];
+};
+
+class ecmcPvPool {
+ public:
+  ecmcPvPool(int maxCount,
+             int initCount,
+             ecmcPvCmdDispatcher *dispatcher,
+             size_t maxArraySize,
+             bool snapshotMode);
+  ~ecmcPvPool();
+
+  // Any thread, lock free. NULL if index not allocated (yet)
+  ecmcPv* get(int index) {
+    if(index < 0 || index >= capacity_.load(std::memory_order_acquire)) {
+      return NULL;
+    }
+    ecmcPvPoolChunk *chunk =
+        chunks_[index / ECMC_PV_POOL_CHUNK_SIZE].load(std::memory_order_relaxed);
+    return chunk->pvs[index % ECMC_PV_POOL_CHUNK_SIZE].get();
+  }
+
+  // Rt state of all slots (MAX_PV_COUNT, also slots without object yet)
+  ecmcPvHotTable* getHotTable() {
+    return hot_;
+  }
+
+  // Number of allocated objects (valid indexes 0..capacity-1)
+  int  getCapacity() {
+    return capacity_.load(std::memory_order_acquire);
+  }
+
+  int  getMaxCount() {
+    return maxCount_;
+  }
+
+  // Rt: request growth if free objects below low water mark (non blocking).
+  // usedCount includes the registration about to be made.
+  void checkGrow(int usedCount);
+  void exeGrowThread();
+
+ private:
+  int  addChunk();
+  bool belowLowWater(int capacity, int usedCount);
+
+  int                            maxCount_;
+  int                            chunkCount_;
+  std::atomic<ecmcPvPoolChunk*> *chunks_;    // Directory
+  ecmcPvHotTable                *hot_;
+  std::atomic<int>               capacity_;  // Written by grow thread only
+  std::atomic<bool>              growRequested_;
+  std::atomic<int>               usedCount_; // Latest from checkGrow()
+  ecmcPvCmdDispatcher           *dispatcher_;
+  size_t                         maxArraySize_;
+  bool                           snapshotMode_;
+  std::atomic<bool>              destructs_; // Set by destructor, read by grow thread
+  epicsEventId                   growEvent_;
+  epicsThreadId                  growThread_;
+};
+
+#endif  /* ECMC_PV_POOL_H_ */
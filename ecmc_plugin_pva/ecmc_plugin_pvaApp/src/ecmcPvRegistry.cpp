@@ -0,0 +1,177 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcPvRegistry.cpp
+*
+*  Created on: Oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+
+#include <string.h>
+#include <stdexcept>
+#include "ecmcPvRegistry.h"
+
+ecmcPvRegistry::ecmcPvRegistry(int slotCount):
+      slotCount_(slotCount),
+      tableSize_(1),
+      table_(NULL),
+      freeSlots_(NULL),
+      freeCount_(0),
+      nextSlot_(0),
+      usedSlots_(NULL),
+      usedPos_(NULL),
+      usedCount_(0)
+{
+  if(slotCount <= 0) {
+    throw std::runtime_error("Error: Invalid registry slot count.");
+  }
+
+  // Load factor max 0.5
+  while(tableSize_ < 2 * slotCount) {
+    tableSize_ <<= 1;
+  }
+  table_ = new ecmcPvRegistryEntry[tableSize_];
+  for(int i = 0; i < tableSize_; ++i) {
+    table_[i].slot   = -1;
+    table_[i].hash   = 0;
+    table_[i].keyLen = 0;
+  }
+
+  freeSlots_ = new int[slotCount];
+  usedSlots_ = new int[slotCount];
+  usedPos_   = new int[slotCount];
+  for(int i = 0; i < slotCount; ++i) {
+    usedPos_[i] = -1;
+  }
+}
+
+ecmcPvRegistry::~ecmcPvRegistry() {
+  delete[] table_;
+  delete[] freeSlots_;
+  delete[] usedSlots_;
+  delete[] usedPos_;
+}
+
+// FNV-1a of "<provider>\0<channel>", keyLen = 0 if too long
+uint32_t ecmcPvRegistry::makeKey(const char *channel, const char *provider,
+                                 char *key, size_t *keyLen) {
+  size_t providerLen = strlen(provider);
+  size_t channelLen  = strlen(channel);
+  *keyLen = 0;
+  if(providerLen + 1 + channelLen > ECMC_PV_REGISTRY_KEY_LEN) {
+    return 0;
+  }
+  memcpy(key, provider, providerLen);
+  key[providerLen] = '\0';
+  memcpy(key + providerLen + 1, channel, channelLen);
+  *keyLen = providerLen + 1 + channelLen;
+
+  uint32_t hash = 2166136261u;
+  for(size_t i = 0; i < *keyLen; ++i) {
+    hash ^= (uint8_t)key[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+// Returns table position of key or of the empty entry ending the probe
+int ecmcPvRegistry::findEntry(const char *key, size_t keyLen, uint32_t hash) {
+  int mask = tableSize_ - 1;
+  int pos  = hash & mask;
+  while(table_[pos].slot >= 0) {
+    if(table_[pos].hash == hash && table_[pos].keyLen == keyLen &&
+       memcmp(table_[pos].key, key, keyLen) == 0) {
+      return pos;
+    }
+    pos = (pos + 1) & mask;
+  }
+  return pos;
+}
+
+int ecmcPvRegistry::find(const char *channel, const char *provider) {
+  char key[ECMC_PV_REGISTRY_KEY_LEN];
+  size_t keyLen = 0;
+  uint32_t hash = makeKey(channel, provider, key, &keyLen);
+  if(keyLen == 0) {
+    return -1;
+  }
+  return table_[findEntry(key, keyLen, hash)].slot;
+}
+
+int ecmcPvRegistry::insert(const char *channel, const char *provider, int slot) {
+  char key[ECMC_PV_REGISTRY_KEY_LEN];
+  size_t keyLen = 0;
+  uint32_t hash = makeKey(channel, provider, key, &keyLen);
+  if(keyLen == 0 || slot < 0 || slot >= slotCount_) {
+    return -1;
+  }
+  ecmcPvRegistryEntry &entry = table_[findEntry(key, keyLen, hash)];
+  entry.slot   = slot;
+  entry.hash   = hash;
+  entry.keyLen = keyLen;
+  memcpy(entry.key, key, keyLen);
+  return 0;
+}
+
+// Backward shift deletion (no tombstones)
+void ecmcPvRegistry::erase(const char *channel, const char *provider) {
+  char key[ECMC_PV_REGISTRY_KEY_LEN];
+  size_t keyLen = 0;
+  uint32_t hash = makeKey(channel, provider, key, &keyLen);
+  if(keyLen == 0) {
+    return;
+  }
+  int mask = tableSize_ - 1;
+  int hole = findEntry(key, keyLen, hash);
+  if(table_[hole].slot < 0) {
+    return;
+  }
+
+  int pos = (hole + 1) & mask;
+  while(table_[pos].slot >= 0) {
+    int home = table_[pos].hash & mask;
+    // Move entry to hole if its home is not in (hole, pos]
+    bool inRange = hole <= pos ? (home > hole && home <= pos)
+                               : (home > hole || home <= pos);
+    if(!inRange) {
+      table_[hole] = table_[pos];
+      hole = pos;
+    }
+    pos = (pos + 1) & mask;
+  }
+  table_[hole].slot = -1;
+}
+
+int ecmcPvRegistry::allocSlot(int capacity) {
+  int slot = -1;
+  if(freeCount_ > 0) {
+    slot = freeSlots_[--freeCount_];
+  } else if(nextSlot_ < capacity && nextSlot_ < slotCount_) {
+    slot = nextSlot_++;
+  } else {
+    return -1;
+  }
+  usedPos_[slot] = usedCount_;
+  usedSlots_[usedCount_++] = slot;
+  return slot;
+}
+
+void ecmcPvRegistry::freeSlot(int slot) {
+  if(slot < 0 || slot >= nextSlot_ || usedPos_[slot] < 0) {
+    return;
+  }
+  // Last used slot takes the place of the freed one
+  int pos  = usedPos_[slot];
+  int last = usedSlots_[--usedCount_];
+  usedSlots_[pos] = last;
+  usedPos_[last]  = pos;
+  usedPos_[slot]  = -1;
+  freeSlots_[freeCount_++] = slot;
+}
+
+int ecmcPvRegistry::getUsedCount() {
+  return usedCount_;
+}
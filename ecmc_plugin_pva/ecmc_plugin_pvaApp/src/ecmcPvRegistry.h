@@ -0,0 +1,74 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcPvRegistry.h
+*
+*  Created on: Oct 17, 2026
+*      Author: anderssandstrom
+*
+*  Index of registered pvs keyed on (provider, channel) and list of
+*  free pv slots. The index is a preallocated open addressing table
+*  (linear probing) so lookup, insert, erase and slot allocation do not
+*  depend on the number of slots and do not allocate. Slots are handed
+*  out in order up to the current pool capacity (see ecmcPvPool),
+*  freed slots are reused first. The used slots are also kept in a
+*  dense list (order not kept at free) for loops over used slots only.
+*  Not thread safe: only used from the thread registering pvs (rt).
+*
+\*************************************************************************/
+
+#ifndef ECMC_PV_REGISTRY_H_
+#define ECMC_PV_REGISTRY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ecmcPvDefs.h"
+
+#define ECMC_PV_REGISTRY_KEY_LEN (ECMC_PV_NAME_MAX_LEN + 16)
+
+struct ecmcPvRegistryEntry {
+  int      slot;    // -1 if empty
+  uint32_t hash;
+  size_t   keyLen;
+  char     key[ECMC_PV_REGISTRY_KEY_LEN];  // "<provider>\0<channel>"
+};
+
+class ecmcPvRegistry {
+ public:
+  explicit ecmcPvRegistry(int slotCount);
+  ~ecmcPvRegistry();
+
+  // Returns slot or -1 if not registered
+  int  find(const char *channel, const char *provider);
+  // Returns 0 or -1 if key too long (or table full)
+  int  insert(const char *channel, const char *provider, int slot);
+  void erase(const char *channel, const char *provider);
+
+  // Returns free slot (< capacity) or -1 if none left
+  int  allocSlot(int capacity);
+  void freeSlot(int slot);
+  int  getUsedCount();
+  // i < getUsedCount()
+  int  getUsedSlot(int i) {
+    return usedSlots_[i];
+  }
+
+ private:
+  static uint32_t makeKey(const char *channel, const char *provider,
+                          char *key, size_t *keyLen);
+  int  findEntry(const char *key, size_t keyLen, uint32_t hash);
+
+  int                  slotCount_;
+  int                  tableSize_;  // power of 2
+  ecmcPvRegistryEntry *table_;
+  int                 *freeSlots_;  // stack of freed slots
+  int                  freeCount_;
+  int                  nextSlot_;   // First never used slot
+  int                 *usedSlots_;  // Dense list of allocated slots
+  int                 *usedPos_;    // Index in usedSlots_ per slot, -1 if free
+  int                  usedCount_;
+};
+
+#endif  /* ECMC_PV_REGISTRY_H_ */
@@ -0,0 +1,95 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcPvSeqLock.h
+*
+*  Created on: Oct 17, 2026
+*      Author: anderssandstrom
+*
+*  Single writer, multi reader value publication (seqlock "latch").
+*  The value is stored in two copies. While the writer updates one copy
+*  readers use the other, so a reader never waits for a preempted
+*  writer, never takes a lock and never makes a syscall. Reads are lock
+*  free, not wait free: a read is retried if the sequence changed while
+*  copying (the writer started writing the copy being read), so a reader
+*  can retry as long as writes overlap its reads.
+*  The copies are stored as relaxed atomic words (no data race for the
+*  reads that overlap a write and are retried), T must be trivially
+*  copyable.
+*
+\*************************************************************************/
+
+#ifndef ECMC_PV_SEQ_LOCK_H_
+#define ECMC_PV_SEQ_LOCK_H_
+
+#include <atomic>
+#include <string.h>
+
+template <typename T>
+class ecmcPvSeqLock {
+ public:
+  ecmcPvSeqLock() : seq_(0) {
+    T value = T();
+    store(0, value);
+    store(1, value);
+  }
+
+  // Only one thread may write at a time
+  void write(const T &value) {
+    unsigned int seq = seq_.load(std::memory_order_relaxed);
+
+    // Readers use copy 1 while copy 0 is written
+    seq_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    store(0, value);
+
+    // Readers use copy 0 while copy 1 is written
+    seq_.store(seq + 2, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_release);
+    store(1, value);
+  }
+
+  T read() const {
+    T value;
+    unsigned int seq;
+    do {
+      seq = seq_.load(std::memory_order_acquire);
+      load(seq & 1, &value);
+      std::atomic_thread_fence(std::memory_order_acquire);
+    } while(seq_.load(std::memory_order_relaxed) != seq);
+    return value;
+  }
+
+  // Incremented by two for each write
+  unsigned int getSequence() const {
+    return seq_.load(std::memory_order_acquire);
+  }
+
+ private:
+  typedef unsigned long word;  // Lock free atomic on all targets
+  enum { wordCount = (sizeof(T) + sizeof(word) - 1) / sizeof(word) };
+
+  void store(int copy, const T &value) {
+    word words[wordCount];
+    words[wordCount - 1] = 0;  // Padding of last word
+    memcpy(words, &value, sizeof(T));
+    for(int i = 0; i < wordCount; ++i) {
+      data_[copy][i].store(words[i], std::memory_order_relaxed);
+    }
+  }
+
+  void load(int copy, T *value) const {
+    word words[wordCount];
+    for(int i = 0; i < wordCount; ++i) {
+      words[i] = data_[copy][i].load(std::memory_order_relaxed);
+    }
+    memcpy(value, words, sizeof(T));
+  }
+
+  std::atomic<unsigned int> seq_;
+  std::atomic<word> data_[2][wordCount];
+};
+
+#endif  /* ECMC_PV_SEQ_LOCK_H_ */
@@ -0,0 +1,208 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcPvStats.h
+*
+*  Created on: Oct 17, 2026
+*      Author: anderssandstrom
+*
+*  Per pv counters and latency histograms. Updated with relaxed atomics
+*  from the rt, worker and monitor threads (no locks, no allocation).
+*  Read by pv_stat() and the iocsh command ecmcPvaReport.
+*
+\*************************************************************************/
+
+#ifndef ECMC_PV_STATS_H_
+#define ECMC_PV_STATS_H_
+
+#include <atomic>
+#include <stdint.h>
+#include "ecmcPvDefs.h"
+
+// Bin 0: < 1us, bin i: [2^(i-1), 2^i) us, last bin: everything above
+#define ECMC_PV_STAT_HIST_BINS 21
+
+class ecmcPvLatencyHist {
+ public:
+  ecmcPvLatencyHist() {
+    reset();
+  }
+
+  void add(uint64_t ns) {
+    uint64_t us = ns / 1000;
+    int bin = us ? 64 - __builtin_clzll(us) : 0;
+    if(bin >= ECMC_PV_STAT_HIST_BINS) {
+      bin = ECMC_PV_STAT_HIST_BINS - 1;
+    }
+    bins_[bin].fetch_add(1, std::memory_order_relaxed);
+    sumNs_.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t max = maxNs_.load(std::memory_order_relaxed);
+    while(ns > max &&
+          !maxNs_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+    count_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  uint64_t getCount() const {
+    return count_.load(std::memory_order_relaxed);
+  }
+
+  double getAvgUs() const {
+    uint64_t count = getCount();
+    if(count == 0) {
+      return 0;
+    }
+    return (double)sumNs_.load(std::memory_order_relaxed) / count / 1000.0;
+  }
+
+  double getMaxUs() const {
+    return (double)maxNs_.load(std::memory_order_relaxed) / 1000.0;
+  }
+
+  unsigned int getBin(int bin) const {
+    return bins_[bin].load(std::memory_order_relaxed);
+  }
+
+  void reset() {
+    count_.store(0, std::memory_order_relaxed);
+    sumNs_.store(0, std::memory_order_relaxed);
+    maxNs_.store(0, std::memory_order_relaxed);
+    for(int i = 0; i < ECMC_PV_STAT_HIST_BINS; ++i) {
+      bins_[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+ private:
+  std::atomic<uint64_t>     count_;
+  std::atomic<uint64_t>     sumNs_;
+  std::atomic<uint64_t>     maxNs_;
+  std::atomic<unsigned int> bins_[ECMC_PV_STAT_HIST_BINS];
+};
+
+struct ecmcPvStats {
+  ecmcPvStats() : eventCountLast(0), rateTimeLastNs(0) {
+    reset();
+  }
+
+  // Any thread (rate bookkeeping is left to updateRate())
+  void reset() {
+    putLatency.reset();
+    visibleLatency.reset();
+    putCount.store(0, std::memory_order_relaxed);
+    eventCount.store(0, std::memory_order_relaxed);
+    coalescedCount.store(0, std::memory_order_relaxed);
+    overrunCount.store(0, std::memory_order_relaxed);
+    busyCount.store(0, std::memory_order_relaxed);
+    reconnectCount.store(0, std::memory_order_relaxed);
+    filteredCount.store(0, std::memory_order_relaxed);
+    queueDepthMax.store(0, std::memory_order_relaxed);
+    skippedCount.store(0, std::memory_order_relaxed);
+    fastReconnectCount.store(0, std::memory_order_relaxed);
+    retryCount.store(0, std::memory_order_relaxed);
+    eventRate.store(0, std::memory_order_relaxed);
+  }
+
+  static void inc(std::atomic<uint64_t> &counter) {
+    counter.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  static void add(std::atomic<uint64_t> &counter, uint64_t value) {
+    counter.fetch_add(value, std::memory_order_relaxed);
+  }
+
+  // Only one writer per counter (no compare exchange needed)
+  static void max(std::atomic<uint64_t> &counter, uint64_t value) {
+    if(value > counter.load(std::memory_order_relaxed)) {
+      counter.store(value, std::memory_order_relaxed);
+    }
+  }
+
+  // Counted by the monitor, same for all handles sharing a channel
+  static bool isChannelStat(int stat) {
+    switch(stat) {
+      case ECMC_PV_STAT_EVENT_COUNT:
+      case ECMC_PV_STAT_EVENT_RATE:
+      case ECMC_PV_STAT_OVERRUN_COUNT:
+      case ECMC_PV_STAT_RECONNECT_COUNT:
+      case ECMC_PV_STAT_FILTERED_COUNT:
+      case ECMC_PV_STAT_QUEUE_DEPTH_MAX:
+      case ECMC_PV_STAT_SKIPPED_COUNT:
+      case ECMC_PV_STAT_FAST_RECONNECT_COUNT:
+      case ECMC_PV_STAT_RETRY_COUNT:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  // Called periodically from one thread (log drain thread)
+  void updateRate(uint64_t nowNs) {
+    uint64_t count = eventCount.load(std::memory_order_relaxed);
+    if(rateTimeLastNs != 0 && nowNs > rateTimeLastNs && count >= eventCountLast) {
+      eventRate.store((double)(count - eventCountLast) * 1e9 / (nowNs - rateTimeLastNs),
+                      std::memory_order_relaxed);
+    }
+    eventCountLast = count;
+    rateTimeLastNs = nowNs;
+  }
+
+  double get(int stat) const {
+    switch(stat) {
+      case ECMC_PV_STAT_PUT_COUNT:
+        return (double)putCount.load(std::memory_order_relaxed);
+      case ECMC_PV_STAT_PUT_LATENCY_AVG:
+        return putLatency.getAvgUs();
+      case ECMC_PV_STAT_PUT_LATENCY_MAX:
+        return putLatency.getMaxUs();
+      case ECMC_PV_STAT_EVENT_COUNT:
+        return (double)eventCount.load(std::memory_order_relaxed);
+      case ECMC_PV_STAT_EVENT_RATE:
+        return eventRate.load(std::memory_order_relaxed);
+      case ECMC_PV_STAT_VISIBLE_LATENCY_AVG:
+        return visibleLatency.getAvgUs();
+      case ECMC_PV_STAT_VISIBLE_LATENCY_MAX:
+        return visibleLatency.getMaxUs();
+      case ECMC_PV_STAT_COALESCED_COUNT:
+        return (double)coalescedCount.load(std::memory_order_relaxed);
+      case ECMC_PV_STAT_OVERRUN_COUNT:
+        return (double)overrunCount.load(std::memory_order_relaxed);
+      case ECMC_PV_STAT_BUSY_COUNT:
+        return (double)busyCount.load(std::memory_order_relaxed);
+      case ECMC_PV_STAT_RECONNECT_COUNT:
+        return (double)reconnectCount.load(std::memory_order_relaxed);
+      case ECMC_PV_STAT_FILTERED_COUNT:
+        return (double)filteredCount.load(std::memory_order_relaxed);
+      case ECMC_PV_STAT_QUEUE_DEPTH_MAX:
+        return (double)queueDepthMax.load(std::memory_order_relaxed);
+      case ECMC_PV_STAT_SKIPPED_COUNT:
+        return (double)skippedCount.load(std::memory_order_relaxed);
+      case ECMC_PV_STAT_FAST_RECONNECT_COUNT:
+        return (double)fastReconnectCount.load(std::memory_order_relaxed);
+      case ECMC_PV_STAT_RETRY_COUNT:
+        return (double)retryCount.load(std::memory_order_relaxed);
+      default:
+        return 0;
+    }
+  }
+
+  ecmcPvLatencyHist     putLatency;      // Worker/pva threads
+  ecmcPvLatencyHist     visibleLatency;  // Rt thread
+  std::atomic<uint64_t> putCount;
+  std::atomic<uint64_t> eventCount;
+  std::atomic<uint64_t> coalescedCount;
+  std::atomic<uint64_t> overrunCount;
+  std::atomic<uint64_t> busyCount;
+  std::atomic<uint64_t> reconnectCount;
+  std::atomic<uint64_t> filteredCount;
+  std::atomic<uint64_t> queueDepthMax;   // Monitor thread
+  std::atomic<uint64_t> skippedCount;
+  std::atomic<uint64_t> fastReconnectCount;
+  std::atomic<uint64_t> retryCount;
+  std::atomic<double>   eventRate;
+  uint64_t              eventCountLast;  // Only accessed by updateRate()
+  uint64_t              rateTimeLastNs;
+};
+
+#endif  /* ECMC_PV_STATS_H_ */
@@ -15,106 +15,1066 @@
 #define ECMC_IS_PLUGIN
 
 
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <vector>
+#include <map>
 #include "ecmcPvaWrap.h"
 #include "ecmcPvRegFunc.h"
+#include "ecmcPvArrayFunc.h"
+#include "ecmcPvCmdDispatcher.h"
+#include "ecmcPvLog.h"
+#include "epicsTime.h"
+#include "epicsThread.h"
+#include "iocsh.h"
 
 pvreg<double>*  pvRegObj;
+pvgetarray<double>* pvGetArrayObj = NULL;
+pvputarray<double>* pvPutArrayObj = NULL;
+ecmcPvCmdDispatcher* pvDispatcher = NULL;
 int maxPvs = ECMC_MAX_PVS_DEFAULT;
+int initPvCount = ECMC_PV_INIT_PV_COUNT_DEFAULT;
+int workerThreads = ECMC_PV_WORKER_THREADS_DEFAULT;
+int maxArraySize = ECMC_PV_MAX_ARRAY_SIZE_DEFAULT;
 
+// Snapshot mode (values taken at start of rt cycle, see ecmcPvSnapshotEntry)
+bool snapshotMode = false;
+uint64_t snapshotCycle = 0;  // Rt only (see snapshotPvs())
+
+// Rt state of all slots (owned by pvPool)
+ecmcPvHotTable *pvHot = NULL;
+
+// Slots of unregistered pvs, freed when the worker is done (only accessed by rt)
+int *pendingRelease = NULL;
+int  pendingReleaseCount = 0;
+
+// Handle returned when a registered pv is registered again without SHARE=1
+// (index by slot of the channel owner, -1 if none, only accessed by rt)
+int *repeatHandle = NULL;
+
+// Request alarm and timeStamp with value (ALARM_TIMESTAMP=1)
+bool alarmTimeStamp = false;
+
+// Client api of registrations without own BACKEND option
+ecmc_pv_backend defaultBackend = ECMC_PV_BACKEND_PVACLIENT;
+
+// pvac providers by provider name (as PvaClient::get() for pvaClient)
+std::map<std::string, pvac::ClientProvider> pvacProviders;
+
+// Pvs of PV and PV_FILE options, registered at construct. The handles are
+// exported as plc consts so plcs need no registration code.
+struct ecmcPvConfigPv {
+  std::string constName;
+  std::string pvName;
+  std::string providerName;
+  std::string options;   // Pv options (only in PV_FILE)
+  int         handle;    // > 0 when registered
+};
+std::vector<ecmcPvConfigPv> configPvs;
+int    configPvsError = 0;
+double connectTimeout = ECMC_PV_CONNECT_TIMEOUT_DEFAULT;
+
+// Backoff of failed channel recreation (RECONNECT_DELAY, RECONNECT_DELAY_MAX)
+double reconnectDelay = ECMC_PV_RECONNECT_DELAY_DEFAULT;
+double reconnectDelayMax = ECMC_PV_RECONNECT_DELAY_MAX_DEFAULT;
+
+// Return last value while reconnecting (SERVE_LAST=1, see pv_stale())
+bool serveLast = false;
+
+// Rt error reporting
+std::atomic<unsigned int> handleErrorCount(0);
+std::atomic<int>          handleErrorOp(ECMC_PV_RT_OP_GET);
+unsigned int              handleErrorCountReported = 0;
+
+void reportRtErrors(void *obj);
+void registerIocsh();
+static int addPv(const char *pvName, const char *providerName, const char *options);
+static int addConfigPv(const char *constName, const char *pvName,
+                       const char *providerName, const char *options);
+static int readPvFile(const char *fileName);
+
+// Option values (whole value, nothing after the number). A rejected value
+// is printed and the setting keeps its previous value.
+static bool parseIntOption(const char *name, const char *value, int min, int *result) {
+  int  tempValue = 0;
+  char extra = 0;
+  if (sscanf(value, "%d %c", &tempValue, &extra) != 1 || tempValue < min) {
+    printf("%s: Error: Invalid %s \"%s\" (integer >= %d), option ignored.\n", __FILE__,
+           name, value, min);
+    return false;
+  }
+  *result = tempValue;
+  return true;
+}
+
+static bool parseBoolOption(const char *name, const char *value, bool *result) {
+  int  tempValue = 0;
+  char extra = 0;
+  if (sscanf(value, "%d %c", &tempValue, &extra) != 1 || (tempValue != 0 && tempValue != 1)) {
+    printf("%s: Error: Invalid %s \"%s\" (1/0), option ignored.\n", __FILE__, name, value);
+    return false;
+  }
+  *result = tempValue != 0;
+  return true;
+}
+
+// Seconds, zeroValid: 0 allowed (else > 0)
+static bool parseSecondsOption(const char *name, const char *value, bool zeroValid,
+                               double *result) {
+  double tempValue = 0;
+  char   extra = 0;
+  if (sscanf(value, "%lf %c", &tempValue, &extra) != 1 || !(tempValue >= 0) ||
+      (!zeroValid && tempValue == 0)) {
+    printf("%s: Error: Invalid %s \"%s\" (seconds %s 0), option ignored.\n", __FILE__,
+           name, value, zeroValid ? ">=" : ">");
+    return false;
+  }
+  *result = tempValue;
+  return true;
+}
+
+// Options separated by ";" (e.g. "MAX_PV_COUNT=100;WORKER_THREADS=4")
 int parseConfigStr(char *configStr) {
-// Only one OPTIONS
-  int tempValue = 0;
-  int nvals = sscanf(configStr, ECMC_PV_OPTION_MAX_PV_COUNT"=%d",&tempValue);
-  if (nvals == 1) {
-    maxPvs = tempValue;
+  if (!configStr || !configStr[0]) {
+    return 0;
   }
+
+  char *pOptions = strdup(configStr);
+  char *pThisOption = pOptions;
+  char *pNextOption = pOptions;
+
+  while (pNextOption && pNextOption[0]) {
+    pNextOption = strchr(pNextOption, ';');
+    if (pNextOption) {
+      *pNextOption = '\0'; /* Terminate */
+      pNextOption++;       /* Jump to (possible) next */
+    }
+    // Allow leading spaces
+    while (*pThisOption == ' ') {
+      pThisOption++;
+    }
+
+    // ECMC_PV_OPTION_MAX_PV_COUNT
+    if (!strncmp(pThisOption, ECMC_PV_OPTION_MAX_PV_COUNT "=", strlen(ECMC_PV_OPTION_MAX_PV_COUNT "="))) {
+      pThisOption += strlen(ECMC_PV_OPTION_MAX_PV_COUNT "=");
+      parseIntOption(ECMC_PV_OPTION_MAX_PV_COUNT, pThisOption, 1, &maxPvs);
+    }
+
+    // ECMC_PV_OPTION_INIT_PV_COUNT
+    else if (!strncmp(pThisOption, ECMC_PV_OPTION_INIT_PV_COUNT "=", strlen(ECMC_PV_OPTION_INIT_PV_COUNT "="))) {
+      pThisOption += strlen(ECMC_PV_OPTION_INIT_PV_COUNT "=");
+      parseIntOption(ECMC_PV_OPTION_INIT_PV_COUNT, pThisOption, 1, &initPvCount);
+    }
+
+    // ECMC_PV_OPTION_WORKER_THREADS
+    else if (!strncmp(pThisOption, ECMC_PV_OPTION_WORKER_THREADS "=", strlen(ECMC_PV_OPTION_WORKER_THREADS "="))) {
+      pThisOption += strlen(ECMC_PV_OPTION_WORKER_THREADS "=");
+      parseIntOption(ECMC_PV_OPTION_WORKER_THREADS, pThisOption, 1, &workerThreads);
+    }
+
+    // ECMC_PV_OPTION_MAX_ARRAY_SIZE
+    else if (!strncmp(pThisOption, ECMC_PV_OPTION_MAX_ARRAY_SIZE "=", strlen(ECMC_PV_OPTION_MAX_ARRAY_SIZE "="))) {
+      pThisOption += strlen(ECMC_PV_OPTION_MAX_ARRAY_SIZE "=");
+      parseIntOption(ECMC_PV_OPTION_MAX_ARRAY_SIZE, pThisOption, 0, &maxArraySize);
+    }
+
+    // ECMC_PV_OPTION_SNAPSHOT
+    else if (!strncmp(pThisOption, ECMC_PV_OPTION_SNAPSHOT "=", strlen(ECMC_PV_OPTION_SNAPSHOT "="))) {
+      pThisOption += strlen(ECMC_PV_OPTION_SNAPSHOT "=");
+      parseBoolOption(ECMC_PV_OPTION_SNAPSHOT, pThisOption, &snapshotMode);
+    }
+
+    // ECMC_PV_OPTION_ALARM_TIMESTAMP
+    else if (!strncmp(pThisOption, ECMC_PV_OPTION_ALARM_TIMESTAMP "=", strlen(ECMC_PV_OPTION_ALARM_TIMESTAMP "="))) {
+      pThisOption += strlen(ECMC_PV_OPTION_ALARM_TIMESTAMP "=");
+      parseBoolOption(ECMC_PV_OPTION_ALARM_TIMESTAMP, pThisOption, &alarmTimeStamp);
+    }
+
+    // ECMC_PV_OPTION_BACKEND
+    else if (!strncmp(pThisOption, ECMC_PV_OPTION_BACKEND "=", strlen(ECMC_PV_OPTION_BACKEND "="))) {
+      pThisOption += strlen(ECMC_PV_OPTION_BACKEND "=");
+      if (ecmcPv::backendFromString(pThisOption, &defaultBackend)) {
+        printf("%s: Error: Invalid backend \"%s\" (%s or %s), using %s.\n", __FILE__,
+               pThisOption, ECMC_PV_BACKEND_NAME_PVACLIENT, ECMC_PV_BACKEND_NAME_PVAC,
+               ecmcPv::backendToString(defaultBackend));
+      }
+    }
+
+    // ECMC_PV_OPTION_PV_FILE
+    else if (!strncmp(pThisOption, ECMC_PV_OPTION_PV_FILE "=", strlen(ECMC_PV_OPTION_PV_FILE "="))) {
+      pThisOption += strlen(ECMC_PV_OPTION_PV_FILE "=");
+      if (readPvFile(pThisOption)) {
+        configPvsError = ECMC_PV_INIT_ERROR;
+      }
+    }
+
+    // ECMC_PV_OPTION_PV (<const name>,<pv name>[,<provider name>])
+    else if (!strncmp(pThisOption, ECMC_PV_OPTION_PV "=", strlen(ECMC_PV_OPTION_PV "="))) {
+      pThisOption += strlen(ECMC_PV_OPTION_PV "=");
+      char *pvName = strchr(pThisOption, ',');
+      char *providerName = pvName ? strchr(pvName + 1, ',') : NULL;
+      if (pvName) {
+        *pvName++ = '\0';
+      }
+      if (providerName) {
+        *providerName++ = '\0';
+      }
+      if (!pvName || addConfigPv(pThisOption, pvName, providerName, NULL)) {
+        printf("%s: Error: Invalid " ECMC_PV_OPTION_PV " option of \"%s\" "
+               "(<const name>,<pv name>[,<provider name>]).\n", __FILE__, pThisOption);
+        configPvsError = ECMC_PV_INIT_ERROR;
+      }
+    }
+
+    // ECMC_PV_OPTION_CONNECT_TIMEOUT
+    else if (!strncmp(pThisOption, ECMC_PV_OPTION_CONNECT_TIMEOUT "=", strlen(ECMC_PV_OPTION_CONNECT_TIMEOUT "="))) {
+      pThisOption += strlen(ECMC_PV_OPTION_CONNECT_TIMEOUT "=");
+      parseSecondsOption(ECMC_PV_OPTION_CONNECT_TIMEOUT, pThisOption, true, &connectTimeout);
+    }
+
+    // ECMC_PV_OPTION_RECONNECT_DELAY_MAX
+    else if (!strncmp(pThisOption, ECMC_PV_OPTION_RECONNECT_DELAY_MAX "=", strlen(ECMC_PV_OPTION_RECONNECT_DELAY_MAX "="))) {
+      pThisOption += strlen(ECMC_PV_OPTION_RECONNECT_DELAY_MAX "=");
+      parseSecondsOption(ECMC_PV_OPTION_RECONNECT_DELAY_MAX, pThisOption, false, &reconnectDelayMax);
+    }
+
+    // ECMC_PV_OPTION_RECONNECT_DELAY
+    else if (!strncmp(pThisOption, ECMC_PV_OPTION_RECONNECT_DELAY "=", strlen(ECMC_PV_OPTION_RECONNECT_DELAY "="))) {
+      pThisOption += strlen(ECMC_PV_OPTION_RECONNECT_DELAY "=");
+      parseSecondsOption(ECMC_PV_OPTION_RECONNECT_DELAY, pThisOption, true, &reconnectDelay);
+    }
+
+    // ECMC_PV_OPTION_SERVE_LAST
+    else if (!strncmp(pThisOption, ECMC_PV_OPTION_SERVE_LAST "=", strlen(ECMC_PV_OPTION_SERVE_LAST "="))) {
+      pThisOption += strlen(ECMC_PV_OPTION_SERVE_LAST "=");
+      parseBoolOption(ECMC_PV_OPTION_SERVE_LAST, pThisOption, &serveLast);
+    }
+
+    pThisOption = pNextOption;
+  }
+  free(pOptions);
   return 0;
 }
 
-// Pre allocate objects at construct to minimize time jitter in runtime
+// Plc const name: [A-Za-z_][A-Za-z0-9_]*
+static bool isConstName(const char *name) {
+  if (!name || !(isalpha((unsigned char)name[0]) || name[0] == '_')) {
+    return false;
+  }
+  for (const char *c = name; *c; ++c) {
+    if (!isalnum((unsigned char)*c) && *c != '_') {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Called while parsing config (before initPvs(), no log yet). Provider
+// defaults to pva.
+static int addConfigPv(const char *constName, const char *pvName,
+                       const char *providerName, const char *options) {
+  if (!isConstName(constName) || !pvName || !pvName[0] ||
+      strlen(pvName) >= ECMC_PV_NAME_MAX_LEN) {
+    return ECMC_PV_INIT_ERROR;
+  }
+  for (size_t i = 0; i < configPvs.size(); ++i) {
+    if (configPvs[i].constName == constName) {
+      printf("%s: Error: Const name \"%s\" used twice.\n", __FILE__, constName);
+      return ECMC_PV_INIT_ERROR;
+    }
+  }
+  ecmcPvConfigPv configPv;
+  configPv.constName    = constName;
+  configPv.pvName       = pvName;
+  configPv.providerName = providerName && providerName[0] ? providerName
+                                                          : ECMC_PV_PROVIDER_DEFAULT;
+  configPv.options      = options ? options : "";
+  configPv.handle       = 0;
+  configPvs.push_back(configPv);
+  return 0;
+}
+
+// One pv per line: <const name> <pv name> [<provider name> [<pv options>]]
+// Empty lines and lines starting with "#" are ignored.
+static int readPvFile(const char *fileName) {
+  FILE *file = fopen(fileName, "r");
+  if (!file) {
+    printf("%s: Error: Failed to open " ECMC_PV_OPTION_PV_FILE " \"%s\".\n", __FILE__,
+           fileName);
+    return ECMC_PV_INIT_ERROR;
+  }
+  char line[512];
+  char constName[ECMC_PV_NAME_MAX_LEN];
+  char pvName[ECMC_PV_NAME_MAX_LEN];
+  char providerName[ECMC_PV_NAME_MAX_LEN];
+  char options[256];
+  int  lineNumber = 0;
+  int  error = 0;
+  while (fgets(line, sizeof(line), file)) {
+    ++lineNumber;
+    char *pLine = line;
+    while (isspace((unsigned char)*pLine)) {
+      pLine++;
+    }
+    if (!pLine[0] || pLine[0] == '#') {
+      continue;
+    }
+    providerName[0] = '\0';
+    options[0] = '\0';
+    if (sscanf(pLine, "%127s %127s %127s %255s", constName, pvName, providerName,
+               options) < 2 ||
+        addConfigPv(constName, pvName, providerName, options)) {
+      printf("%s: Error: %s:%d: Invalid line (<const name> <pv name> "
+             "[<provider name> [<pv options>]]).\n", __FILE__, fileName, lineNumber);
+      error = ECMC_PV_INIT_ERROR;
+    }
+  }
+  fclose(file);
+  return error;
+}
+
+// Options of pv_reg_asyn() separated by ";" (e.g. "QUEUE_SIZE=4;DEADBAND=0.1")
+struct ecmcPvRegOptions {
+  int         queueSize;    // 0: server default
+  bool        pipeline;
+  std::string fields;       // Empty: default
+  bool        readOnly;     // No put created
+  bool        share;        // Own handle on channel of a registered pv
+  ecmc_pv_backend backend;  // Only used by first registration of a pv
+  ecmcPvMonitorOptions monitor;
+};
+
+static int parseRegOptions(const char *pvName, const char *optionsStr,
+                           ecmcPvRegOptions *options) {
+  options->queueSize   = 0;
+  options->pipeline    = false;
+  options->fields.clear();
+  options->readOnly    = false;
+  options->share       = false;
+  options->backend     = defaultBackend;
+  options->monitor.deadband    = 0;
+  options->monitor.deadbandRel = 0;
+  options->monitor.drainLast   = false;
+  options->monitor.reconnectDelay    = reconnectDelay;
+  options->monitor.reconnectDelayMax =
+      reconnectDelayMax > reconnectDelay ? reconnectDelayMax : reconnectDelay;
+  if (!optionsStr || !optionsStr[0]) {
+    return 0;
+  }
+
+  char *pOptions = strdup(optionsStr);
+  char *pThisOption = pOptions;
+  char *pNextOption = pOptions;
+  int tempValue = 0;
+  double tempDouble = 0;
+  int error = 0;
+
+  while (pNextOption && pNextOption[0]) {
+    pNextOption = strchr(pNextOption, ';');
+    if (pNextOption) {
+      *pNextOption = '\0'; /* Terminate */
+      pNextOption++;       /* Jump to (possible) next */
+    }
+    // Allow leading spaces
+    while (*pThisOption == ' ') {
+      pThisOption++;
+    }
+
+    // ECMC_PV_REG_OPTION_QUEUE_SIZE
+    if (!strncmp(pThisOption, ECMC_PV_REG_OPTION_QUEUE_SIZE "=", strlen(ECMC_PV_REG_OPTION_QUEUE_SIZE "="))) {
+      pThisOption += strlen(ECMC_PV_REG_OPTION_QUEUE_SIZE "=");
+      if (sscanf(pThisOption, "%d", &tempValue) == 1 && tempValue > 0) {
+        options->queueSize = tempValue;
+      }
+    }
+
+    // ECMC_PV_REG_OPTION_PIPELINE
+    else if (!strncmp(pThisOption, ECMC_PV_REG_OPTION_PIPELINE "=", strlen(ECMC_PV_REG_OPTION_PIPELINE "="))) {
+      pThisOption += strlen(ECMC_PV_REG_OPTION_PIPELINE "=");
+      if (sscanf(pThisOption, "%d", &tempValue) == 1) {
+        options->pipeline = tempValue != 0;
+      }
+    }
+
+    // ECMC_PV_REG_OPTION_FIELDS (comma separated, must include value)
+    else if (!strncmp(pThisOption, ECMC_PV_REG_OPTION_FIELDS "=", strlen(ECMC_PV_REG_OPTION_FIELDS "="))) {
+      pThisOption += strlen(ECMC_PV_REG_OPTION_FIELDS "=");
+      options->fields = pThisOption;
+    }
+
+    // ECMC_PV_REG_OPTION_DEADBAND_REL (before DEADBAND, same prefix)
+    else if (!strncmp(pThisOption, ECMC_PV_REG_OPTION_DEADBAND_REL "=", strlen(ECMC_PV_REG_OPTION_DEADBAND_REL "="))) {
+      pThisOption += strlen(ECMC_PV_REG_OPTION_DEADBAND_REL "=");
+      if (sscanf(pThisOption, "%lf", &tempDouble) == 1 && tempDouble >= 0) {
+        options->monitor.deadbandRel = tempDouble;
+      }
+    }
+
+    // ECMC_PV_REG_OPTION_DEADBAND
+    else if (!strncmp(pThisOption, ECMC_PV_REG_OPTION_DEADBAND "=", strlen(ECMC_PV_REG_OPTION_DEADBAND "="))) {
+      pThisOption += strlen(ECMC_PV_REG_OPTION_DEADBAND "=");
+      if (sscanf(pThisOption, "%lf", &tempDouble) == 1 && tempDouble >= 0) {
+        options->monitor.deadband = tempDouble;
+      }
+    }
+
+    // ECMC_PV_REG_OPTION_DRAIN_LAST
+    else if (!strncmp(pThisOption, ECMC_PV_REG_OPTION_DRAIN_LAST "=", strlen(ECMC_PV_REG_OPTION_DRAIN_LAST "="))) {
+      pThisOption += strlen(ECMC_PV_REG_OPTION_DRAIN_LAST "=");
+      if (sscanf(pThisOption, "%d", &tempValue) == 1) {
+        options->monitor.drainLast = tempValue != 0;
+      }
+    }
+
+    // ECMC_PV_REG_OPTION_READ_ONLY
+    else if (!strncmp(pThisOption, ECMC_PV_REG_OPTION_READ_ONLY "=", strlen(ECMC_PV_REG_OPTION_READ_ONLY "="))) {
+      pThisOption += strlen(ECMC_PV_REG_OPTION_READ_ONLY "=");
+      if (sscanf(pThisOption, "%d", &tempValue) == 1) {
+        options->readOnly = tempValue != 0;
+      }
+    }
+
+    // ECMC_PV_REG_OPTION_SHARE
+    else if (!strncmp(pThisOption, ECMC_PV_REG_OPTION_SHARE "=", strlen(ECMC_PV_REG_OPTION_SHARE "="))) {
+      pThisOption += strlen(ECMC_PV_REG_OPTION_SHARE "=");
+      if (sscanf(pThisOption, "%d", &tempValue) == 1) {
+        options->share = tempValue != 0;
+      }
+    }
+
+    // ECMC_PV_REG_OPTION_BACKEND
+    else if (!strncmp(pThisOption, ECMC_PV_REG_OPTION_BACKEND "=", strlen(ECMC_PV_REG_OPTION_BACKEND "="))) {
+      pThisOption += strlen(ECMC_PV_REG_OPTION_BACKEND "=");
+      if (ecmcPv::backendFromString(pThisOption, &options->backend)) {
+        ecmcPvLogMsg(ECMC_PV_LOG_ERROR, 0, ECMC_PV_PLC_CMD_PV_REG_ASYN "(): %s: Invalid backend \"%s\"",
+                     pvName, pThisOption);
+        error = ECMC_PV_REG_ERROR;
+      }
+    }
+
+    else if (pThisOption[0]) {
+      ecmcPvLogMsg(ECMC_PV_LOG_ERROR, 0, ECMC_PV_PLC_CMD_PV_REG_ASYN "(): %s: Invalid option \"%s\"",
+                   pvName, pThisOption);
+      error = ECMC_PV_REG_ERROR;
+    }
+
+    pThisOption = pNextOption;
+  }
+  free(pOptions);
+  return error;
+}
+
+// One pvac provider per provider name, shared by all channels and retries
+static pvac::ClientProvider getPvacProvider(const std::string &providerName) {
+  std::map<std::string, pvac::ClientProvider>::iterator it =
+    pvacProviders.find(providerName);
+  if(it != pvacProviders.end()) {
+    return it->second;
+  }
+  pvac::ClientProvider provider(providerName);  // Throws if unknown
+  pvacProviders[providerName] = provider;
+  return provider;
+}
+
+// Monitor request, e.g. "record[queueSize=4,pipeline=true]field(value)"
+static std::string buildRequest(const ecmcPvRegOptions &options) {
+  std::string request;
+  if(options.queueSize > 0 || options.pipeline) {
+    char queueSize[32];
+    snprintf(queueSize, sizeof(queueSize), "queueSize=%d", options.queueSize);
+    request = "record[";
+    if(options.queueSize > 0) {
+      request += queueSize;
+    }
+    if(options.pipeline) {
+      request += options.queueSize > 0 ? ",pipeline=true" : "pipeline=true";
+    }
+    request += "]";
+  }
+  request += "field(";
+  if(!options.fields.empty()) {
+    request += options.fields;
+  } else {
+    request += alarmTimeStamp ? "value,alarm,timeStamp" : "value";
+  }
+  request += ")";
+  return request;
+}
+
+// Pre allocate objects at construct to minimize time jitter in runtime.
+// More objects are allocated by the pool (low prio thread) when needed.
 int initPvs() {
+  if(ecmcPvLogInit(maxPvs)) {
+    return ECMC_PV_INIT_ERROR;
+  }
   try{
-    for(int i = 0; i < maxPvs; ++i ) {
-      ecmcPvPtr pv = ecmcPv::create("DummyName","DummyProvider","value",i+1);
-      pvVector.push_back(pv);
+    // Each pv is queued at most once so queue size maxPvs is enough
+    pvDispatcher = new ecmcPvCmdDispatcher(workerThreads, maxPvs);
+    pvRegistry = new ecmcPvRegistry(maxPvs);
+    pendingRelease = new int[maxPvs];
+    repeatHandle = new int[maxPvs];
+    for(int i = 0; i < maxPvs; ++i) {
+      repeatHandle[i] = -1;
     }
+    // Objects allocated in chunks up to maxPvs (not in rt). Config pvs are
+    // registered before the grow thread could add objects.
+    pvPool = new ecmcPvPool(maxPvs, initPvCount + (int)configPvs.size(), pvDispatcher,
+                            maxArraySize, snapshotMode);
+    pvHot = pvPool->getHotTable();
+    pvHot->setServeLast(serveLast);
+    ecmcPvLogSetPollFunc(reportRtErrors, NULL);
+    registerIocsh();
   }
   catch(std::exception &e){
-    std::cerr << "Error:  init: " << e.what() << "\n";
+    ecmcPvLogMsg(ECMC_PV_LOG_ERROR, 0, "Init: %s", e.what());
     return ECMC_PV_INIT_ERROR;
   }
   return 0;
 }
 
+// Rt: return slots of unregistered pvs to the registry when released by worker
+static void reclaimSlots() {
+  for(int i = 0; i < pendingReleaseCount;) {
+    if(pvPool->get(pendingRelease[i])->released()) {
+      pvRegistry->freeSlot(pendingRelease[i]);
+      // No longer refreshed by snapshotPvs()
+      pvHot->snapshot(pendingRelease[i]).error = ECMC_PV_NOT_CONNECTED;
+      pendingRelease[i] = pendingRelease[--pendingReleaseCount];
+    } else {
+      ++i;
+    }
+  }
+}
+
+// Returns handle (> 0) or -error. Registering a registered pv again returns
+// the same handle (plcs re-registering do not use up the pool). With SHARE=1
+// the registration gets an own handle (own put) sharing the channel and
+// monitor of the first registration (options of the first registration apply).
+int regPv(const char *pvName, const char *providerName, const char *options) {
+  if (getEcmcEpicsIOCState()!=ECMC_IOC_STARTED_STATE) {
+    return -ECMC_PV_IOC_NOT_STARTED;
+  }
+  return addPv(pvName, providerName, options);
+}
+
+// Registration without ioc state check (config pvs, before the ioc is started)
+static int addPv(const char *pvName, const char *providerName, const char *options) {
+  if(!pvRegistry) {
+    return -ECMC_PV_INIT_ERROR;
+  }
+
+  try{
+    ecmcPvRegOptions regOptions;
+    if(parseRegOptions(pvName, options, &regOptions)) {
+      return -ECMC_PV_REG_ERROR;
+    }
+
+    // Slot of object owning the channel if pv already registered
+    int source = pvRegistry->find(pvName, providerName);
+    if(source >= 0 && !regOptions.share && repeatHandle[source] >= 0) {
+      return repeatHandle[source] + 1;
+    }
+
+    reclaimSlots();
+    // Ask pool for more objects before it runs out (this one included)
+    pvPool->checkGrow(pvRegistry->getUsedCount() + 1);
+    int index = pvRegistry->allocSlot(pvPool->getCapacity());
+    if(index < 0) {
+      ecmcPvLogMsg(ECMC_PV_LOG_ERROR, 0, ECMC_PV_PLC_CMD_PV_REG_ASYN "(): %s: No free pv object",
+                   pvName);
+      return -ECMC_PV_REG_ERROR;
+    }
+
+    if(source >= 0) {
+      if(pvPool->get(index)->regSharedCmd(pvPool->get(source), pvName, providerName,
+                                          regOptions.readOnly)) {
+        pvRegistry->freeSlot(index);
+        return -ECMC_PV_REG_ERROR;
+      }
+      if(!regOptions.share) {
+        repeatHandle[source] = index;
+      }
+      return index + 1;
+    }
+
+    if(pvRegistry->insert(pvName, providerName, index)) {
+      pvRegistry->freeSlot(index);
+      ecmcPvLogMsg(ECMC_PV_LOG_ERROR, 0, ECMC_PV_PLC_CMD_PV_REG_ASYN "(): %s: Pv name too long",
+                   pvName);
+      return -ECMC_PV_REG_ERROR;
+    }
+
+    // One client per provider name (channels of all pvs share it)
+    PvaClientPtr pvaClient;
+    pvac::ClientProvider pvacProvider;
+    if(regOptions.backend == ECMC_PV_BACKEND_PVACLIENT) {
+      pvaClient = PvaClient::get(providerName);
+    } else {
+      pvacProvider = getPvacProvider(providerName);
+    }
+    if(pvPool->get(index)->regCmd(pvaClient,pvacProvider,pvName,providerName,
+                               buildRequest(regOptions),
+                               regOptions.monitor, regOptions.readOnly,
+                               regOptions.backend)) {
+      pvRegistry->erase(pvName, providerName);
+      pvRegistry->freeSlot(index);
+      return -ECMC_PV_REG_ERROR;
+    }
+    repeatHandle[index] = regOptions.share ? -1 : index;
+    // return handle to object (1 higher than index to avoid 0)
+    return index + 1;
+  }
+  catch(std::exception &e){
+    ecmcPvLogMsg(ECMC_PV_LOG_ERROR, 0, ECMC_PV_PLC_CMD_PV_REG_ASYN "(): %s", e.what());
+    return -ECMC_PV_REG_ERROR;
+  }
+}
+
+// Register the pvs of the PV and PV_FILE options (at construct). All reg
+// cmds are queued at once, the workers connect the channels in parallel.
+int regConfigPvs() {
+  if(configPvsError) {
+    return configPvsError;
+  }
+  for(size_t i = 0; i < configPvs.size(); ++i) {
+    ecmcPvConfigPv &configPv = configPvs[i];
+    int handle = addPv(configPv.pvName.c_str(), configPv.providerName.c_str(),
+                       configPv.options.c_str());
+    if(handle < 0) {
+      printf("%s: Error: Register of %s (%s) failed (0x%x).\n", __FILE__,
+             configPv.pvName.c_str(), configPv.constName.c_str(), -handle);
+      return ECMC_PV_INIT_ERROR;
+    }
+    configPv.handle = handle;
+  }
+  return 0;
+}
+
+// Called at enter of realtime: wait until all config pvs are connected (or
+// failed) or CONNECT_TIMEOUT, then print the startup report. Pvs still not
+// connected keep connecting (plcs check pv_connected()).
+int waitConfigPvs() {
+  if(configPvs.empty() || !pvHot) {
+    return 0;
+  }
+  uint64_t startNs = epicsMonotonicGet();
+  uint64_t timeoutNs = (uint64_t)(connectTimeout * 1e9);
+  size_t connected = 0;
+  for(;;) {
+    size_t done = 0;
+    connected = 0;
+    for(size_t i = 0; i < configPvs.size(); ++i) {
+      uint32_t state = pvHot->getState(configPvs[i].handle - 1);
+      connected += state == ECMC_PV_STATE_TYPED;
+      done += state == ECMC_PV_STATE_TYPED || state == ECMC_PV_STATE_ERROR;
+    }
+    if(done == configPvs.size() || epicsMonotonicGet() - startNs >= timeoutNs) {
+      break;
+    }
+    epicsThreadSleep(ECMC_PV_CONNECT_POLL_PERIOD_S);
+  }
+
+  printf("%s: %zu of %zu config pvs connected in %.3fs (" ECMC_PV_OPTION_CONNECT_TIMEOUT
+         "=%.3fs):\n", __FILE__, connected, configPvs.size(),
+         (epicsMonotonicGet() - startNs) / 1e9, connectTimeout);
+  printf("%4s %-24s %-40s %-9s %-12s\n", "hdl", "const", "pv", "provider", "state");
+  for(size_t i = 0; i < configPvs.size(); ++i) {
+    const ecmcPvConfigPv &configPv = configPvs[i];
+    printf("%4d %-24s %-40s %-9s %-12s\n", configPv.handle, configPv.constName.c_str(),
+           configPv.pvName.c_str(), configPv.providerName.c_str(),
+           ecmcPv::stateToString(pvHot->getState(configPv.handle - 1)));
+  }
+  return 0;
+}
+
+int getConfigPvCount() {
+  return (int)configPvs.size();
+}
+
+const char* getConfigPvConstName(int index) {
+  return configPvs[index].constName.c_str();
+}
+
+const char* getConfigPvName(int index) {
+  return configPvs[index].pvName.c_str();
+}
+
+int getConfigPvHandle(int index) {
+  return configPvs[index].handle;
+}
+
 void* getPvRegObj() {
   pvRegObj = new pvreg<double>();
   return (void*) pvRegObj;
 }
 
+void* getPvGetArrayObj() {
+  pvGetArrayObj = new pvgetarray<double>();
+  return (void*) pvGetArrayObj;
+}
+
+void* getPvPutArrayObj() {
+  pvPutArrayObj = new pvputarray<double>();
+  return (void*) pvPutArrayObj;
+}
+
+// Bounds checked handle to object lookup (no exceptions, safe in rt)
+static inline ecmcPv* getPvObj(int handle, ecmc_pv_rt_op op) {
+  ecmcPv *pv = pvPool ? pvPool->get(handle-1) : NULL;
+  if(!pv) {
+    handleErrorOp.store(op, std::memory_order_relaxed);
+    handleErrorCount.fetch_add(1, std::memory_order_release);
+    return NULL;
+  }
+  return pv;
+}
+
+// Bounds checked handle to hot table slot (-1 if out of range, as getPvObj())
+static inline int getHotIndex(int handle, ecmc_pv_rt_op op) {
+  if(!pvPool || handle < 1 || handle > pvPool->getCapacity()) {
+    handleErrorOp.store(op, std::memory_order_relaxed);
+    handleErrorCount.fetch_add(1, std::memory_order_release);
+    return -1;
+  }
+  return handle - 1;
+}
+
 int getError(int handle) {
-  try{
-    return pvVector.at(handle-1)->getError();
-  }    
-  catch(std::exception &e){
-    std::cerr << "Error: " ECMC_PV_PLC_CMD_PV_GET_ERR "(): " << e.what() << "\n";
-    return 0.0;
+  ecmcPv *pv = getPvObj(handle, ECMC_PV_RT_OP_GET);
+  if(!pv) {
+    return ECMC_PV_HANDLE_OUT_OF_RANGE;
   }
-  return 0.0;
+  return pv->getError();
 }  
 
-// Normal plc functions
+// Returns 0 or error. Slot reused when the worker has destroyed the channel.
+int unregPv(int handle) {
+  ecmcPv *pv = getPvObj(handle, ECMC_PV_RT_OP_UNREG);
+  if(!pv) {
+    return ECMC_PV_HANDLE_OUT_OF_RANGE;
+  }
+  int error = pv->unregCmd();
+  if(error) {
+    return error;
+  }
+  // Next registration of the pv gets a new handle
+  int source = pvHot->state(handle - 1).source;
+  if(repeatHandle[source] == handle - 1) {
+    repeatHandle[source] = -1;
+  }
+  // Last handle of the channel: name free for new registrations now.
+  // Slots are reused when released (the slot owning a shared channel when
+  // the last handle using it is gone).
+  if(pv->getChannelRefs() == 0) {
+    pvRegistry->erase(pv->getChannelName().c_str(), pv->getProviderName().c_str());
+  }
+  pendingRelease[pendingReleaseCount++] = handle - 1;
+  return 0;
+}
+
+int getUsedPvCount() {
+  return pvRegistry ? pvRegistry->getUsedCount() : 0;
+}
+
+// Normal plc functions (called from rt: no exceptions, no allocation, no io)
 int exePutDataCmd(int handle, double value) {
-  try{
-    pvVector.at(handle-1)->putCmd(value);
-    return 0;
-  }    
-  catch(std::exception &e){
-    std::cerr << "Error: " ECMC_PV_PLC_CMD_PV_PUT_ASYN "(): " << e.what() << "\n";
-    return ECMC_PV_PUT_ERROR;
+  ecmcPv *pv = getPvObj(handle, ECMC_PV_RT_OP_PUT);
+  if(!pv) {
+    return ECMC_PV_HANDLE_OUT_OF_RANGE;
+  }
+  return pv->putCmd(value);
+}
+
+int exePutInt64Cmd(int handle, int64_t value) {
+  ecmcPv *pv = getPvObj(handle, ECMC_PV_RT_OP_PUT);
+  if(!pv) {
+    return ECMC_PV_HANDLE_OUT_OF_RANGE;
+  }
+  return pv->putInt64Cmd(value);
+}
+
+// Value (with alarm/timeStamp) used by plc in this cycle
+// Only the hot table is touched (pv object only to report errors)
+static int getLastPvValue(int handle, ecmcPvValue *value) {
+  int index = getHotIndex(handle, ECMC_PV_RT_OP_GET);
+  if(index < 0) {
+    return ECMC_PV_HANDLE_OUT_OF_RANGE;
   }
-  return ECMC_PV_PUT_ERROR;
+  int error = 0;
+  if(snapshotMode) {
+    // Plain table load, same value during whole cycle
+    const ecmcPvSnapshotEntry &entry = pvHot->snapshot(index);
+    error = entry.error;
+    if(!error) {
+      *value = entry.value;
+    }
+  } else {
+    error = pvHot->read(index, value);
+  }
+  if(error) {
+    pvPool->get(index)->setRtError(ECMC_PV_RT_OP_GET, error);
+  }
+  return error;
 }
 
 double getLastValue(int handle) {
-  try{
-    return pvVector.at(handle-1)->getLastReadValue();
-  }    
-  catch(std::exception &e){
-    std::cerr << "Error: " ECMC_PV_PLC_CMD_PV_GET_VALUE "(): "<< e.what() << "\n";
+  ecmcPvValue value;
+  if(getLastPvValue(handle, &value)) {
     return 0;
   }
+  return ecmcPv::valueToDouble(value);
+}
+
+// Exact for integer pvs (no conversion via double)
+int getLastValueInt64(int handle, int64_t *value) {
+  ecmcPvValue latest;
+  int error = getLastPvValue(handle, &latest);
+  if(error) {
+    return error;
+  }
+  *value = ecmcPv::valueToInt64(latest);
   return 0;
 }
 
-int getBusy(int handle) {
-  try{
-    return pvVector.at(handle-1)->busy();
-  }    
-  catch(std::exception &e){
-    std::cerr << "Error: " ECMC_PV_PLC_CMD_PV_GET_BUSY "(): "<< e.what() << "\n";
+int getSeverity(int handle) {
+  ecmcPvValue value;
+  if(getLastPvValue(handle, &value)) {
+    return ECMC_PV_SEVERITY_INVALID;
+  }
+  return value.severity;
+}
+
+int64_t getAgeNs(int handle) {
+  ecmcPvValue value;
+  if(getLastPvValue(handle, &value)) {
+    return ECMC_PV_AGE_INVALID;
+  }
+  return ecmcPv::valueAgeNs(value);
+}
+
+uint64_t getUpdateCount(int handle) {
+  ecmcPvValue value;
+  if(getLastPvValue(handle, &value)) {
     return 0;
   }
+  return value.updateCount;
+}
+
+// Called from pvaRealtime() at start of each rt cycle (SNAPSHOT=1). Only
+// used slots are visited, the array of a shared channel is taken once.
+void snapshotPvs() {
+  if(!snapshotMode || !pvPool || !pvRegistry) {
+    return;
+  }
+  ++snapshotCycle;
+  int usedCount = pvRegistry->getUsedCount();
+  for(int i = 0; i < usedCount; ++i) {
+    int index = pvRegistry->getUsedSlot(i);
+    ecmcPvSnapshotEntry &entry = pvHot->snapshot(index);
+    entry.error = pvHot->read(index, &entry.value);
+    if(!entry.error && entry.value.kind == ECMC_PV_VALUE_ARRAY) {
+      pvPool->get(index)->snapshotArray(snapshotCycle);
+    }
+  }
+}
+
+int exePutArrayCmd(int handle, double *data, int count) {
+  ecmcPv *pv = getPvObj(handle, ECMC_PV_RT_OP_PUT);
+  if(!pv) {
+    return ECMC_PV_HANDLE_OUT_OF_RANGE;
+  }
+  if(count < 0) {
+    count = 0;
+  }
+  return pv->putArrayCmd(data, (size_t)count);
+}
+
+// Returns number of elements copied to data or -error
+int getLastArray(int handle, double *data, int size) {
+  ecmcPv *pv = getPvObj(handle, ECMC_PV_RT_OP_GET);
+  size_t count = 0;
+  if(!pv) {
+    return -ECMC_PV_HANDLE_OUT_OF_RANGE;
+  }
+  if(size < 0) {
+    size = 0;
+  }
+  int error = pv->getLastReadArray(data, (size_t)size, &count);
+  if(error) {
+    return -error;
+  }
+  return (int)count;
+}
+
+int exePutLatestCmd(int handle, double value) {
+  ecmcPv *pv = getPvObj(handle, ECMC_PV_RT_OP_PUT);
+  if(!pv) {
+    return ECMC_PV_HANDLE_OUT_OF_RANGE;
+  }
+  return pv->putLatestCmd(value);
+}
+
+int getPutCoalescedCount(int handle) {
+  ecmcPv *pv = getPvObj(handle, ECMC_PV_RT_OP_GET);
+  if(!pv) {
+    return 0;
+  }
+  return (int)pv->getPutCoalescedCount();
+}
+
+// Async cmds issued until batchCommit() are handed to the workers at once
+int batchBegin() {
+  if(!pvDispatcher) {
+    return ECMC_PV_INIT_ERROR;
+  }
+  return pvDispatcher->beginBatch();
+}
+
+// Returns number of queued cmds or -error
+int batchCommit() {
+  if(!pvDispatcher) {
+    return -ECMC_PV_INIT_ERROR;
+  }
+  int count = pvDispatcher->commitBatch();
+  if(count < 0) {
+    return -ECMC_PV_PUT_ERROR;
+  }
+  return count;
+}
+
+double getStat(int handle, int stat) {
+  ecmcPv *pv = getPvObj(handle, ECMC_PV_RT_OP_GET);
+  if(!pv) {
+    return 0;
+  }
+  return pv->getStat(stat);
+}
+
+int resetStats(int handle) {
+  ecmcPv *pv = getPvObj(handle, ECMC_PV_RT_OP_GET);
+  if(!pv) {
+    return ECMC_PV_HANDLE_OUT_OF_RANGE;
+  }
+  pv->resetStats();
   return 0;
 }
 
+int getBusy(int handle) {
+  int index = getHotIndex(handle, ECMC_PV_RT_OP_GET);
+  if(index < 0) {
+    return 0;
+  }
+  return pvHot->busy(index);
+}
+
 int getConnected(int handle) {
-  try{
-    return pvVector.at(handle-1)->connected();
-  }    
-  catch(std::exception &e){
-    std::cerr << "Error: " ECMC_PV_PLC_CMD_PV_GET_BUSY "(): "<< e.what() << "\n";
+  int index = getHotIndex(handle, ECMC_PV_RT_OP_GET);
+  if(index < 0) {
     return 0;
   }
-  return 0;
+  return pvHot->connected(index);
+}
+
+// ECMC_PV_STATE_* (one load, see ecmcPvHotState)
+int getState(int handle) {
+  int index = getHotIndex(handle, ECMC_PV_RT_OP_GET);
+  if(index < 0) {
+    return ECMC_PV_STATE_UNREGISTERED;
+  }
+  return (int)pvHot->getState(index);
+}
+
+// Last value returned while reconnecting (SERVE_LAST=1) or kept (one load)
+int getStale(int handle) {
+  int index = getHotIndex(handle, ECMC_PV_RT_OP_GET);
+  if(index < 0) {
+    return 0;
+  }
+  return pvHot->stale(index);
+}
+
+// Collect errors from rt thread, update stats and retry failed channels
+// (called by log drain thread)
+void reportRtErrors(void *obj) {
+  unsigned int count = handleErrorCount.load(std::memory_order_acquire);
+  if(count != handleErrorCountReported) {
+    ecmcPvLogMsg(ECMC_PV_LOG_ERROR, 0, "%s(): %s (0x%x, %u times)",
+                 ecmcPv::rtOpToString((ecmc_pv_rt_op)handleErrorOp.load()),
+                 ecmcPv::errorToString(ECMC_PV_HANDLE_OUT_OF_RANGE),
+                 ECMC_PV_HANDLE_OUT_OF_RANGE, count - handleErrorCountReported);
+    handleErrorCountReported = count;
+  }
+  uint64_t nowNs = epicsMonotonicGet();
+  if(!pvPool) {
+    return;
+  }
+  int capacity = pvPool->getCapacity();
+  for(int i = 0; i < capacity; ++i) {
+    pvPool->get(i)->reportRtErrors();
+    pvPool->get(i)->updateStats(nowNs);
+    pvPool->get(i)->checkRetry(nowNs);
+  }
+}
+
+// Print statistics of all registered pvs (level 1: also histograms)
+void report(int level) {
+  printf("%4s %-40s %-12s %10s %8s %9s %9s %10s %8s %9s %6s %6s %4s %6s %6s %4s\n",
+         "hdl", "pv", "state", "puts", "put[us]", "putMx[us]", "evt[Hz]", "events",
+         "vis[us]", "visMx[us]", "coal", "ovr", "qMx", "skip", "busy", "rcon");
+  if(!pvPool) {
+    return;
+  }
+  int capacity = pvPool->getCapacity();
+  for(int i = 0; i < capacity; ++i) {
+    if(pvPool->get(i)->inUse()) {
+      pvPool->get(i)->report(level);
+    }
+  }
+  printf("Pv objects: %d allocated (max %d), %d registered\n", capacity,
+         pvPool->getMaxCount(), pvRegistry ? pvRegistry->getUsedCount() : 0);
+}
+
+/* iocsh: ecmcPvaReport [<level>] */
+static const iocshArg reportArg0 = {"level (0=counters, 1=histograms)", iocshArgInt};
+static const iocshArg *const reportArgs[] = {&reportArg0};
+static const iocshFuncDef reportFuncDef = {"ecmcPvaReport", 1, reportArgs};
+static void reportCallFunc(const iocshArgBuf *args) {
+  report(args[0].ival);
+}
+
+void registerIocsh() {
+  static bool iocshRegistered = false;
+  if(!iocshRegistered) {
+    iocshRegister(&reportFuncDef, reportCallFunc);
+    iocshRegistered = true;
+  }
 }
 
 void cleanup() {
- try{
-    pvVector.clear();
+  // Stop log drain thread first (its poll func reportRtErrors() uses the pool)
+  ecmcPvLogStop();
+  try{
+    // Stop workers before pv objects are destructed
+    delete pvDispatcher;
+    pvDispatcher = NULL;
+    delete pvPool;
+    pvPool = NULL;
+    pvHot = NULL;
+    delete pvRegistry;
+    pvRegistry = NULL;
+    pvacProviders.clear();
+    delete[] pendingRelease;
+    pendingRelease = NULL;
+    delete[] repeatHandle;
+    repeatHandle = NULL;
     delete pvRegObj;
+    delete pvGetArrayObj;
+    delete pvPutArrayObj;
   }    
   catch(std::exception &e){
-    std::cerr << "Error: Destruct(): "<< e.what() << "\n";
-    return;
+    printf("Error: Destruct(): %s\n", e.what());
   }
+  // Workers, pool grow thread and pv callbacks stopped (they all log)
+  ecmcPvLogCleanup();
 }
@@ -12,6 +12,7 @@
 #ifndef ECMC_PVA_WRAP_H_
 #define ECMC_PVA_WRAP_H_
 
+#include <stdint.h>
 #include "ecmcPvDefs.h"
 
 # ifdef __cplusplus
@@ -19,12 +20,39 @@ extern "C" {
 # endif  // ifdef __cplusplus
 
   int    initPvs();
+  void   snapshotPvs();
   int    parseConfigStr(char *configStr);
+  int    regPv(const char *pvName, const char *providerName, const char *options);
+  int    regConfigPvs();
+  int    waitConfigPvs();
+  int    getConfigPvCount();
+  const char* getConfigPvConstName(int index);
+  const char* getConfigPvName(int index);
+  int    getConfigPvHandle(int index);
+  int    unregPv(int handle);
+  int    getUsedPvCount();  // Pv objects in use (registration thread)
   void*  getPvRegObj();
+  void*  getPvGetArrayObj();
+  void*  getPvPutArrayObj();
   int    exePutDataCmd(int handle, double data);
   double getLastValue(int handle);
+  int    exePutInt64Cmd(int handle, int64_t data);
+  int    getLastValueInt64(int handle, int64_t *data);
+  int    getSeverity(int handle);
+  int64_t  getAgeNs(int handle);
+  uint64_t getUpdateCount(int handle);
+  int    exePutArrayCmd(int handle, double *data, int count);
+  int    getLastArray(int handle, double *data, int size);
+  int    exePutLatestCmd(int handle, double data);
+  int    getPutCoalescedCount(int handle);
+  int    batchBegin();
+  double getStat(int handle, int stat);
+  int    resetStats(int handle);
+  int    batchCommit();
   int    getBusy(int handle);
   int    getConnected(int handle);  
+  int    getState(int handle);
+  int    getStale(int handle);
   int    getError(int handle);
   void   cleanup();
 